@@ -25,10 +25,27 @@
 
 #include <libfm/fm-gtk.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "app-config.h"
 
 static void fm_app_config_finalize              (GObject *object);
+static void on_profile_changed(GFileMonitor* mon, GFile* gf, GFile* other,
+                               GFileMonitorEvent evt, FmAppConfig* cfg);
+
+/* contents of profile file as it was last loaded or written */
+static char* saved_profile = NULL;
+/* set while profile is written in background */
+static gboolean saving_profile = FALSE;
+/* number of the latest profile write, a background write which is
+ * not the latest anymore is skipped so older data never wins */
+static guint profile_serial = 0;
+/* held while the profile file is written */
+G_LOCK_DEFINE_STATIC(profile_file);
+
+/* for reloading profile when it's changed by someone else */
+static GFileMonitor* profile_mon = NULL;
+static guint reload_handler = 0;
 
 G_DEFINE_TYPE(FmAppConfig, fm_app_config, FM_CONFIG_TYPE);
 
@@ -49,6 +66,18 @@ static void fm_app_config_finalize(GObject *object)
     g_return_if_fail(IS_FM_APP_CONFIG(object));
 
     cfg = FM_APP_CONFIG(object);
+    if(reload_handler)
+    {
+        g_source_remove(reload_handler);
+        reload_handler = 0;
+    }
+    if(profile_mon)
+    {
+        g_signal_handlers_disconnect_by_func(profile_mon, on_profile_changed, cfg);
+        g_file_monitor_cancel(profile_mon);
+        g_object_unref(profile_mon);
+        profile_mon = NULL;
+    }
     if(cfg->wallpapers_configured > 0)
     {
         int i;
@@ -128,7 +157,10 @@ void fm_app_config_load_from_key_file(FmAppConfig* cfg, GKeyFile* kf)
             g_free(cfg->wallpapers[i]);
         g_free(cfg->wallpapers);
     }
+    cfg->wallpapers = NULL;
+    cfg->wallpapers_configured = 0;
     g_free(cfg->wallpaper);
+    cfg->wallpaper = NULL;
     fm_key_file_get_int(kf, "desktop", "wallpapers_configured", &cfg->wallpapers_configured);
     if(cfg->wallpapers_configured > 0)
     {
@@ -192,6 +224,7 @@ void fm_app_config_load_from_key_file(FmAppConfig* cfg, GKeyFile* kf)
     fm_key_file_get_int(kf, "ui", "win_height", &cfg->win_height);
 
     fm_key_file_get_int(kf, "ui", "splitter_pos", &cfg->splitter_pos);
+    fm_key_file_get_bool(kf, "ui", "restore_session", &cfg->restore_session);
 
     fm_key_file_get_int(kf, "ui", "side_pane_mode", &tmp_int);
     cfg->side_pane_mode = (FmSidePaneMode)tmp_int;
@@ -263,7 +296,13 @@ void fm_app_config_load_from_profile(FmAppConfig* cfg, const char* name)
         g_free(path);
         path = g_build_filename(g_get_user_config_dir(), "pcmanfm", name, "pcmanfm.conf", NULL);
         if(g_key_file_load_from_file(kf, path, 0, NULL))
+        {
             fm_app_config_load_from_key_file(cfg, kf);
+            /* remember it so we don't write it back if nothing is changed */
+            g_free(saved_profile);
+            if(!g_file_get_contents(path, &saved_profile, NULL, NULL))
+                saved_profile = NULL;
+        }
     }
     g_free(path);
 
@@ -274,9 +313,64 @@ void fm_app_config_load_from_profile(FmAppConfig* cfg, const char* name)
         cfg->desktop_font = g_strdup("Sans 12");
 }
 
-void fm_app_config_save_profile(FmAppConfig* cfg, const char* name)
+static GString* profile_to_string(FmAppConfig* cfg)
+{
+    GString* buf = g_string_sized_new(1024);
+
+    g_string_append(buf, "[config]\n");
+    g_string_append_printf(buf, "bm_open_method=%d\n", cfg->bm_open_method);
+    if(cfg->su_cmd && *cfg->su_cmd)
+        g_string_append_printf(buf, "su_cmd=%s\n", cfg->su_cmd);
+
+    g_string_append(buf, "\n[volume]\n");
+    g_string_append_printf(buf, "mount_on_startup=%d\n", cfg->mount_on_startup);
+    g_string_append_printf(buf, "mount_removable=%d\n", cfg->mount_removable);
+    g_string_append_printf(buf, "autorun=%d\n", cfg->autorun);
+
+    g_string_append(buf, "\n[desktop]\n");
+    g_string_append_printf(buf, "wallpaper_mode=%d\n", cfg->wallpaper_mode);
+    g_string_append_printf(buf, "wallpaper_common=%d\n", cfg->wallpaper_common);
+    if (cfg->wallpapers && cfg->wallpapers_configured > 0)
+    {
+        int i;
+
+        g_string_append_printf(buf, "wallpapers_configured=%d\n", cfg->wallpapers_configured);
+        for (i = 0; i < cfg->wallpapers_configured; i++)
+            if (cfg->wallpapers[i])
+                g_string_append_printf(buf, "wallpaper%d=%s\n", i, cfg->wallpapers[i]);
+    }
+    if (cfg->wallpaper_common)
+        g_string_append_printf(buf, "wallpaper=%s\n", cfg->wallpaper ? cfg->wallpaper : "");
+    //FIXME: should desktop_bg and wallpaper_mode be set for each desktop too?
+    g_string_append_printf(buf, "desktop_bg=#%02x%02x%02x\n", cfg->desktop_bg.red/257, cfg->desktop_bg.green/257, cfg->desktop_bg.blue/257);
+    g_string_append_printf(buf, "desktop_fg=#%02x%02x%02x\n", cfg->desktop_fg.red/257, cfg->desktop_fg.green/257, cfg->desktop_fg.blue/257);
+    g_string_append_printf(buf, "desktop_shadow=#%02x%02x%02x\n", cfg->desktop_shadow.red/257, cfg->desktop_shadow.green/257, cfg->desktop_shadow.blue/257);
+    if(cfg->desktop_font && *cfg->desktop_font)
+        g_string_append_printf(buf, "desktop_font=%s\n", cfg->desktop_font);
+    g_string_append_printf(buf, "show_wm_menu=%d\n", cfg->show_wm_menu);
+    g_string_append_printf(buf, "sort_type=%d\n", cfg->desktop_sort_type);
+    g_string_append_printf(buf, "sort_by=%d\n", cfg->desktop_sort_by);
+
+    g_string_append(buf, "\n[ui]\n");
+    g_string_append_printf(buf, "always_show_tabs=%d\n", cfg->always_show_tabs);
+    g_string_append_printf(buf, "max_tab_chars=%d\n", cfg->max_tab_chars);
+    /* g_string_append_printf(buf, "hide_close_btn=%d\n", cfg->hide_close_btn); */
+    g_string_append_printf(buf, "win_width=%d\n", cfg->win_width);
+    g_string_append_printf(buf, "win_height=%d\n", cfg->win_height);
+    g_string_append_printf(buf, "splitter_pos=%d\n", cfg->splitter_pos);
+    g_string_append_printf(buf, "restore_session=%d\n", cfg->restore_session);
+    g_string_append_printf(buf, "side_pane_mode=%d\n", cfg->side_pane_mode);
+    g_string_append_printf(buf, "view_mode=%d\n", cfg->view_mode);
+    g_string_append_printf(buf, "show_hidden=%d\n", cfg->show_hidden);
+    g_string_append_printf(buf, "sort_type=%d\n", cfg->sort_type);
+    g_string_append_printf(buf, "sort_by=%d\n", cfg->sort_by);
+    return buf;
+}
+
+/* returns path of profile file, or NULL if its dir cannot be created */
+static char* get_profile_file(const char* name)
 {
-    char* path = NULL;;
+    char* path = NULL;
     char* dir_path;
 
     if(!name || !*name)
@@ -284,61 +378,282 @@ void fm_app_config_save_profile(FmAppConfig* cfg, const char* name)
 
     dir_path = g_build_filename(g_get_user_config_dir(), "pcmanfm", name, NULL);
     if(g_mkdir_with_parents(dir_path, 0700) != -1)
+        path = g_build_filename(dir_path, "pcmanfm.conf", NULL);
+    g_free(dir_path);
+    return path;
+}
+
+/* check if profile differs from the saved one, and take it over if it does */
+static GString* get_changed_profile(FmAppConfig* cfg)
+{
+    GString* buf = profile_to_string(cfg);
+    if(saved_profile && strcmp(saved_profile, buf->str) == 0)
     {
-        GString* buf = g_string_sized_new(1024);
-
-        g_string_append(buf, "[config]\n");
-        g_string_append_printf(buf, "bm_open_method=%d\n", cfg->bm_open_method);
-        if(cfg->su_cmd && *cfg->su_cmd)
-            g_string_append_printf(buf, "su_cmd=%s\n", cfg->su_cmd);
-
-        g_string_append(buf, "\n[volume]\n");
-        g_string_append_printf(buf, "mount_on_startup=%d\n", cfg->mount_on_startup);
-        g_string_append_printf(buf, "mount_removable=%d\n", cfg->mount_removable);
-        g_string_append_printf(buf, "autorun=%d\n", cfg->autorun);
-
-        g_string_append(buf, "\n[desktop]\n");
-        g_string_append_printf(buf, "wallpaper_mode=%d\n", cfg->wallpaper_mode);
-        g_string_append_printf(buf, "wallpaper_common=%d\n", cfg->wallpaper_common);
-        if (cfg->wallpapers && cfg->wallpapers_configured > 0)
-        {
-            int i;
+        g_string_free(buf, TRUE);
+        return NULL;
+    }
+    g_free(saved_profile);
+    saved_profile = g_strndup(buf->str, buf->len);
+    return buf;
+}
+
+void fm_app_config_save_profile(FmAppConfig* cfg, const char* name)
+{
+    char* path;
+    GString* buf;
+
+    buf = get_changed_profile(cfg);
+    if(!buf) /* nothing is changed */
+        return;
+    path = get_profile_file(name);
+    if(path)
+    {
+        /* wait for a background write which is in progress, and
+         * make a queued one skip its older data */
+        G_LOCK(profile_file);
+        ++profile_serial;
+        g_file_set_contents(path, buf->str, buf->len, NULL);
+        G_UNLOCK(profile_file);
+        g_free(path);
+    }
+    g_string_free(buf, TRUE);
+}
+
+typedef struct
+{
+    char* path;
+    GString* buf;
+    guint serial;
+    GError* err;
+}ProfileWrite;
 
-            g_string_append_printf(buf, "wallpapers_configured=%d\n", cfg->wallpapers_configured);
-            for (i = 0; i < cfg->wallpapers_configured; i++)
-                if (cfg->wallpapers[i])
-                    g_string_append_printf(buf, "wallpaper%d=%s\n", i, cfg->wallpapers[i]);
+static gboolean on_profile_saved(gpointer user_data)
+{
+    ProfileWrite* pw = (ProfileWrite*)user_data;
+    if(pw->err)
+    {
+        g_warning("failed to save config: %s", pw->err->message);
+        /* force writing it again next time if nothing newer was written */
+        if(pw->serial == profile_serial)
+        {
+            g_free(saved_profile);
+            saved_profile = NULL;
         }
-        if (cfg->wallpaper_common)
-            g_string_append_printf(buf, "wallpaper=%s\n", cfg->wallpaper ? cfg->wallpaper : "");
-        //FIXME: should desktop_bg and wallpaper_mode be set for each desktop too?
-        g_string_append_printf(buf, "desktop_bg=#%02x%02x%02x\n", cfg->desktop_bg.red/257, cfg->desktop_bg.green/257, cfg->desktop_bg.blue/257);
-        g_string_append_printf(buf, "desktop_fg=#%02x%02x%02x\n", cfg->desktop_fg.red/257, cfg->desktop_fg.green/257, cfg->desktop_fg.blue/257);
-        g_string_append_printf(buf, "desktop_shadow=#%02x%02x%02x\n", cfg->desktop_shadow.red/257, cfg->desktop_shadow.green/257, cfg->desktop_shadow.blue/257);
-        if(cfg->desktop_font && *cfg->desktop_font)
-            g_string_append_printf(buf, "desktop_font=%s\n", cfg->desktop_font);
-        g_string_append_printf(buf, "show_wm_menu=%d\n", cfg->show_wm_menu);
-        g_string_append_printf(buf, "sort_type=%d\n", cfg->desktop_sort_type);
-        g_string_append_printf(buf, "sort_by=%d\n", cfg->desktop_sort_by);
-
-        g_string_append(buf, "\n[ui]\n");
-        g_string_append_printf(buf, "always_show_tabs=%d\n", cfg->always_show_tabs);
-        g_string_append_printf(buf, "max_tab_chars=%d\n", cfg->max_tab_chars);
-        /* g_string_append_printf(buf, "hide_close_btn=%d\n", cfg->hide_close_btn); */
-        g_string_append_printf(buf, "win_width=%d\n", cfg->win_width);
-        g_string_append_printf(buf, "win_height=%d\n", cfg->win_height);
-        g_string_append_printf(buf, "splitter_pos=%d\n", cfg->splitter_pos);
-        g_string_append_printf(buf, "side_pane_mode=%d\n", cfg->side_pane_mode);
-        g_string_append_printf(buf, "view_mode=%d\n", cfg->view_mode);
-        g_string_append_printf(buf, "show_hidden=%d\n", cfg->show_hidden);
-        g_string_append_printf(buf, "sort_type=%d\n", cfg->sort_type);
-        g_string_append_printf(buf, "sort_by=%d\n", cfg->sort_by);
+        g_error_free(pw->err);
+    }
+    g_free(pw->path);
+    g_string_free(pw->buf, TRUE);
+    g_slice_free(ProfileWrite, pw);
+    saving_profile = FALSE;
+    return FALSE;
+}
 
-        path = g_build_filename(dir_path, "pcmanfm.conf", NULL);
-        g_file_set_contents(path, buf->str, buf->len, NULL);
+/* runs in a worker thread */
+static gboolean write_profile_job(GIOSchedulerJob* job, GCancellable* cancellable,
+                                  gpointer user_data)
+{
+    ProfileWrite* pw = (ProfileWrite*)user_data;
+    G_LOCK(profile_file);
+    /* skip it if the profile was written synchronously meanwhile */
+    if(pw->serial == profile_serial)
+        g_file_set_contents(pw->path, pw->buf->str, pw->buf->len, &pw->err);
+    G_UNLOCK(profile_file);
+    g_io_scheduler_job_send_to_mainloop_async(job, on_profile_saved, pw, NULL);
+    return FALSE;
+}
+
+/**
+ * fm_app_config_save_profile_async
+ * @cfg: config to save
+ * @name: profile name
+ * Return value: %FALSE if previous write is still in progress
+ *
+ * Writes the profile file in background if its contents are changed
+ * since the last time it was loaded or saved. The file is replaced
+ * atomically so readers never see a partially written config.
+ */
+gboolean fm_app_config_save_profile_async(FmAppConfig* cfg, const char* name)
+{
+    char* path;
+    GString* buf;
+    ProfileWrite* pw;
+
+    if(saving_profile)
+        return FALSE;
+    buf = get_changed_profile(cfg);
+    if(!buf)
+        return TRUE;
+    path = get_profile_file(name);
+    if(!path)
+    {
         g_string_free(buf, TRUE);
+        return TRUE;
+    }
+    pw = g_slice_new0(ProfileWrite);
+    pw->path = path;
+    pw->buf = buf;
+    /* only the main thread changes it */
+    pw->serial = ++profile_serial;
+    saving_profile = TRUE;
+    g_io_scheduler_push_job(write_profile_job, pw, NULL, G_PRIORITY_DEFAULT, NULL);
+    return TRUE;
+}
+
+
+/* values of keys which have "changed::" handlers */
+typedef struct
+{
+    FmWallpaperMode wallpaper_mode;
+    char* wallpaper;
+    char** wallpapers;
+    int wallpapers_configured;
+    gboolean wallpaper_common;
+    GdkColor desktop_bg;
+    GdkColor desktop_fg;
+    GdkColor desktop_shadow;
+    char* desktop_font;
+    FmSidePaneMode side_pane_mode;
+}ConfigSnapshot;
+
+static void take_snapshot(FmAppConfig* cfg, ConfigSnapshot* snap)
+{
+    int i;
+    snap->wallpaper_mode = cfg->wallpaper_mode;
+    snap->wallpaper = g_strdup(cfg->wallpaper);
+    snap->wallpapers_configured = cfg->wallpapers_configured;
+    snap->wallpapers = NULL;
+    if(cfg->wallpapers_configured > 0)
+    {
+        snap->wallpapers = g_new(char*, cfg->wallpapers_configured);
+        for(i = 0; i < cfg->wallpapers_configured; i++)
+            snap->wallpapers[i] = g_strdup(cfg->wallpapers[i]);
+    }
+    snap->wallpaper_common = cfg->wallpaper_common;
+    snap->desktop_bg = cfg->desktop_bg;
+    snap->desktop_fg = cfg->desktop_fg;
+    snap->desktop_shadow = cfg->desktop_shadow;
+    snap->desktop_font = g_strdup(cfg->desktop_font);
+    snap->side_pane_mode = cfg->side_pane_mode;
+}
+
+static void free_snapshot(ConfigSnapshot* snap)
+{
+    int i;
+    for(i = 0; i < snap->wallpapers_configured; i++)
+        g_free(snap->wallpapers[i]);
+    g_free(snap->wallpapers);
+    g_free(snap->wallpaper);
+    g_free(snap->desktop_font);
+}
+
+static gboolean wallpaper_changed(FmAppConfig* cfg, ConfigSnapshot* snap)
+{
+    int i;
+    if(snap->wallpaper_mode != cfg->wallpaper_mode
+       || snap->wallpaper_common != cfg->wallpaper_common
+       || g_strcmp0(snap->wallpaper, cfg->wallpaper) != 0
+       || !gdk_color_equal(&snap->desktop_bg, &cfg->desktop_bg)
+       || snap->wallpapers_configured != cfg->wallpapers_configured)
+        return TRUE;
+    for(i = 0; i < cfg->wallpapers_configured; i++)
+        if(g_strcmp0(snap->wallpapers[i], cfg->wallpapers[i]) != 0)
+            return TRUE;
+    return FALSE;
+}
+
+static gboolean on_reload_profile(gpointer user_data)
+{
+    FmAppConfig* cfg = (FmAppConfig*)user_data;
+    GKeyFile* kf;
+    char* path;
+    char* data;
+    gsize len;
+    ConfigSnapshot snap;
+
+    reload_handler = 0;
+    path = g_file_get_path(g_object_get_data(G_OBJECT(profile_mon), "file"));
+    if(!g_file_get_contents(path, &data, &len, NULL))
+    {
         g_free(path);
+        return FALSE;
+    }
+    g_free(path);
+    /* it's our own write or no real change */
+    if(saving_profile || (saved_profile && strcmp(saved_profile, data) == 0))
+    {
+        g_free(data);
+        return FALSE;
+    }
+    kf = g_key_file_new();
+    if(g_key_file_load_from_data(kf, data, len, 0, NULL))
+    {
+        take_snapshot(cfg, &snap);
+        fm_app_config_load_from_key_file(cfg, kf);
+        if(!cfg->desktop_font)
+            cfg->desktop_font = g_strdup("Sans 12");
+        g_free(saved_profile);
+        saved_profile = data;
+        data = NULL;
+
+        /* notify only about keys which were really changed */
+        if(wallpaper_changed(cfg, &snap))
+            fm_config_emit_changed(FM_CONFIG(cfg), "wallpaper");
+        if(!gdk_color_equal(&snap.desktop_fg, &cfg->desktop_fg)
+           || !gdk_color_equal(&snap.desktop_shadow, &cfg->desktop_shadow))
+            fm_config_emit_changed(FM_CONFIG(cfg), "desktop_text");
+        if(g_strcmp0(snap.desktop_font, cfg->desktop_font) != 0)
+            fm_config_emit_changed(FM_CONFIG(cfg), "desktop_font");
+        if(snap.side_pane_mode != cfg->side_pane_mode)
+            fm_config_emit_changed(FM_CONFIG(cfg), "side_pane_mode");
+        free_snapshot(&snap);
+    }
+    g_key_file_free(kf);
+    g_free(data);
+    return FALSE;
+}
+
+static void on_profile_changed(GFileMonitor* mon, GFile* gf, GFile* other,
+                               GFileMonitorEvent evt, FmAppConfig* cfg)
+{
+    switch(evt)
+    {
+    case G_FILE_MONITOR_EVENT_CHANGES_DONE_HINT:
+    case G_FILE_MONITOR_EVENT_CREATED:
+        /* editors may write the file in several steps so wait a little */
+        if(reload_handler)
+            g_source_remove(reload_handler);
+        reload_handler = g_timeout_add(500, on_reload_profile, cfg);
+        break;
+    default: ;
     }
-    g_free(dir_path);
 }
 
+/**
+ * fm_app_config_watch_profile
+ * @cfg: config loaded with fm_app_config_load_from_profile()
+ * @name: profile name
+ *
+ * Starts monitoring the user profile file. When it's changed by another
+ * process the config is reloaded and "changed::" signals are emitted
+ * only for those keys whose values are really changed.
+ */
+void fm_app_config_watch_profile(FmAppConfig* cfg, const char* name)
+{
+    char* path;
+    GFile* gf;
+
+    if(profile_mon)
+        return;
+    path = get_profile_file(name);
+    if(!path)
+        return;
+    gf = g_file_new_for_path(path);
+    g_free(path);
+    profile_mon = g_file_monitor_file(gf, G_FILE_MONITOR_NONE, NULL, NULL);
+    if(profile_mon)
+    {
+        g_object_set_data_full(G_OBJECT(profile_mon), "file", g_object_ref(gf), g_object_unref);
+        g_signal_connect(profile_mon, "changed", G_CALLBACK(on_profile_changed), cfg);
+    }
+    g_object_unref(gf);
+}
@@ -79,6 +79,7 @@ struct _FmAppConfig
     int win_width;
     int win_height;
     int splitter_pos;
+    gboolean restore_session;
 
     FmSidePaneMode side_pane_mode;
 
@@ -123,6 +124,8 @@ void fm_app_config_load_from_profile(FmAppConfig* cfg, const char* name);
 void fm_app_config_load_from_key_file(FmAppConfig* cfg, GKeyFile* kf);
 
 void fm_app_config_save_profile(FmAppConfig* cfg, const char* name);
+gboolean fm_app_config_save_profile_async(FmAppConfig* cfg, const char* name);
+void fm_app_config_watch_profile(FmAppConfig* cfg, const char* name);
 
 
 G_END_DECLS
@@ -34,6 +34,7 @@
 
 #include "pref.h"
 #include "main-win.h"
+#include "utils.h"
 
 #include "gseal-gtk-compat.h"
 
@@ -147,6 +148,9 @@ static guint desktop_text_changed = 0;
 static guint desktop_font_changed = 0;
 static guint icon_theme_changed = 0;
 static GtkAccelGroup* acc_grp = NULL;
+/* desktop popup menu is built once and shared by all desktops */
+static GtkMenu* desktop_popup = NULL;
+static FmDesktop* popup_desktop = NULL; /* desktop the shared actions work on */
 
 static PangoFontDescription* font_desc = NULL;
 
@@ -327,7 +331,8 @@ static void fm_desktop_destroy(GtkObject *object)
             g_free(bg);
         }
 
-        g_object_unref(self->popup);
+        if(popup_desktop == self)
+            popup_desktop = NULL;
     }
 
 #if GTK_CHECK_VERSION(3, 0, 0)
@@ -337,14 +342,52 @@ static void fm_desktop_destroy(GtkObject *object)
 #endif
 }
 
+static void create_desktop_popup(void)
+{
+    GtkUIManager* ui;
+    GtkActionGroup* act_grp;
+
+    ui = gtk_ui_manager_new();
+    act_grp = gtk_action_group_new("Desktop");
+    gtk_action_group_set_translation_domain(act_grp, NULL);
+    gtk_action_group_add_actions(act_grp, desktop_actions, G_N_ELEMENTS(desktop_actions), NULL);
+    gtk_action_group_add_radio_actions(act_grp, desktop_sort_type_actions,
+                                       G_N_ELEMENTS(desktop_sort_type_actions),
+                                       app_config->desktop_sort_type,
+                                       G_CALLBACK(on_sort_type), NULL);
+    gtk_action_group_add_radio_actions(act_grp, desktop_sort_by_actions,
+                                       G_N_ELEMENTS(desktop_sort_by_actions),
+                                       app_config->desktop_sort_by,
+                                       G_CALLBACK(on_sort_by), NULL);
+
+    gtk_ui_manager_insert_action_group(ui, act_grp, 0);
+    gtk_ui_manager_add_ui_from_string(ui, desktop_menu_xml, -1, NULL);
+
+    acc_grp = (GtkAccelGroup*)g_object_ref(gtk_ui_manager_get_accel_group(ui));
+    desktop_popup = GTK_MENU(g_object_ref_sink(gtk_ui_manager_get_widget(ui, "/popup")));
+
+    g_object_unref(act_grp);
+    g_object_unref(ui);
+}
+
+static void show_desktop_popup(FmDesktop* desktop, guint32 time)
+{
+    popup_desktop = desktop;
+    if(gtk_menu_get_attach_widget(desktop_popup) != GTK_WIDGET(desktop))
+    {
+        if(gtk_menu_get_attach_widget(desktop_popup))
+            gtk_menu_detach(desktop_popup);
+        gtk_menu_attach_to_widget(desktop_popup, GTK_WIDGET(desktop), NULL);
+    }
+    gtk_menu_popup(desktop_popup, NULL, NULL, NULL, NULL, 3, time);
+}
+
 static void fm_desktop_init(FmDesktop *self)
 {
     GdkScreen* screen = gtk_widget_get_screen((GtkWidget*)self);
     GdkWindow* root;
     //PangoContext* pc;
     GtkTargetList* targets;
-    GtkUIManager* ui;
-    GtkActionGroup* act_grp;
 
     gtk_window_set_default_size((GtkWindow*)self, gdk_screen_get_width(screen), gdk_screen_get_height(screen));
     gtk_window_move(GTK_WINDOW(self), 0, 0);
@@ -399,33 +442,11 @@ static void fm_desktop_init(FmDesktop *self)
     load_items(self);
 
     /* popup menu */
-    ui = gtk_ui_manager_new();
-    act_grp = gtk_action_group_new("Desktop");
-    gtk_action_group_set_translation_domain(act_grp, NULL);
-    gtk_action_group_add_actions(act_grp, desktop_actions, G_N_ELEMENTS(desktop_actions), self);
-    gtk_action_group_add_radio_actions(act_grp, desktop_sort_type_actions,
-                                       G_N_ELEMENTS(desktop_sort_type_actions),
-                                       app_config->desktop_sort_type,
-                                       G_CALLBACK(on_sort_type), self);
-    gtk_action_group_add_radio_actions(act_grp, desktop_sort_by_actions,
-                                       G_N_ELEMENTS(desktop_sort_by_actions),
-                                       app_config->desktop_sort_by,
-                                       G_CALLBACK(on_sort_by), self);
-
-    gtk_ui_manager_insert_action_group(ui, act_grp, 0);
-    gtk_ui_manager_add_ui_from_string(ui, desktop_menu_xml, -1, NULL);
-
-    if(!acc_grp)
-        acc_grp = (GtkAccelGroup*)g_object_ref(gtk_ui_manager_get_accel_group(ui));
-
+    if(!desktop_popup)
+        create_desktop_popup();
     gtk_window_add_accel_group(GTK_WINDOW(self), acc_grp);
 
-    self->popup = GTK_MENU(g_object_ref_sink(gtk_ui_manager_get_widget(ui, "/popup")));
-
     hand_cursor = gdk_cursor_new(GDK_HAND2);
-
-    g_object_unref(act_grp);
-    g_object_unref(ui);
 }
 
 
@@ -494,6 +515,8 @@ static void on_folder_finish_loading(FmFolder* folder, gpointer user_data)
     guint i;
     /* FIXME: we need to free old positions first?? */
 
+    pcmanfm_trace_mark("desktop folder loaded", NULL, NULL);
+
     /* the desktop folder is just loaded, apply desktop items and positions */
     for(i = 0; i < n_screens; i++)
     {
@@ -645,6 +668,14 @@ void fm_desktop_manager_finalize()
         g_object_unref(acc_grp);
     acc_grp = NULL;
 
+    if(desktop_popup)
+    {
+        gtk_widget_destroy(GTK_WIDGET(desktop_popup));
+        g_object_unref(desktop_popup);
+        desktop_popup = NULL;
+    }
+    popup_desktop = NULL;
+
     if(hand_cursor)
     {
         gdk_cursor_unref(hand_cursor);
@@ -834,12 +865,7 @@ static gboolean on_button_press(GtkWidget* w, GdkEventButton* evt)
             if(evt->button == 3)  /* right click on the blank area => desktop popup menu */
             {
                 if(! app_config->show_wm_menu)
-                {
-                    if(gtk_menu_get_attach_widget(self->popup))
-                        gtk_menu_detach(self->popup);
-                    gtk_menu_attach_to_widget(self->popup, w, NULL);
-                    gtk_menu_popup(self->popup, NULL, NULL, NULL, NULL, 3, evt->time);
-                }
+                    show_desktop_popup(self, evt->time);
             }
             else if(evt->button == 1)
             {
@@ -1020,6 +1046,8 @@ static gboolean on_key_press(GtkWidget* w, GdkEventKey* evt)
     FmDesktopItem* item;
     int modifier = (evt->state & (GDK_SHIFT_MASK | GDK_CONTROL_MASK | GDK_MOD1_MASK));
     FmPathList* sels;
+    /* accelerators of the shared popup should act on this desktop */
+    popup_desktop = desktop;
     switch (evt->keyval)
     {
     case GDK_Menu:
@@ -1031,7 +1059,7 @@ static gboolean on_key_press(GtkWidget* w, GdkEventKey* evt)
             else
             {
                 if(! app_config->show_wm_menu)
-                    gtk_menu_popup(desktop->popup, NULL, NULL, NULL, NULL, 3, evt->time);
+                    show_desktop_popup(desktop, evt->time);
             }
             return TRUE;
         }
@@ -1184,6 +1212,7 @@ static void on_direction_changed(GtkWidget* w, GtkTextDirection prev)
 static void on_realize(GtkWidget* w)
 {
     FmDesktop* self = (FmDesktop*)w;
+    gint64 t = pcmanfm_trace_now();
 
     GTK_WIDGET_CLASS(fm_desktop_parent_class)->realize(w);
     gtk_window_set_skip_pager_hint(GTK_WINDOW(w), TRUE);
@@ -1192,8 +1221,11 @@ static void on_realize(GtkWidget* w)
 
     if(! self->gc)
         self->gc = gdk_gc_new(gtk_widget_get_window(w));
+    pcmanfm_trace_phase("desktop realize", t);
 
+    t = pcmanfm_trace_now();
     update_background(self, -1);
+    pcmanfm_trace_phase("desktop update_background", t);
 }
 
 static gboolean on_focus_in(GtkWidget* w, GdkEventFocus* evt)
@@ -2257,6 +2289,9 @@ static void on_invert_select(GtkAction* act, gpointer user_data)
 static void on_create_new(GtkAction* act, FmDesktop* desktop)
 {
     const char* name = gtk_action_get_name(act);
+    desktop = popup_desktop;
+    if(!desktop)
+        return;
     if(strcmp(name, "NewFolder") == 0)
         name = TEMPL_NAME_FOLDER;
     else if(strcmp(name, "NewBlank") == 0)
@@ -2269,7 +2304,9 @@ static void on_create_new(GtkAction* act, FmDesktop* desktop)
 static void on_sort_type(GtkAction* act, GtkRadioAction *cur, FmDesktop* desktop)
 {
     app_config->desktop_sort_type = gtk_radio_action_get_current_value(cur);
-    gtk_tree_sortable_set_sort_column_id(GTK_TREE_SORTABLE(desktop->model),
+    if(!desktop_model)
+        return;
+    gtk_tree_sortable_set_sort_column_id(GTK_TREE_SORTABLE(desktop_model),
                                          app_config->desktop_sort_by,
                                          app_config->desktop_sort_type);
 }
@@ -2277,7 +2314,9 @@ static void on_sort_type(GtkAction* act, GtkRadioAction *cur, FmDesktop* desktop
 static void on_sort_by(GtkAction* act, GtkRadioAction *cur, FmDesktop* desktop)
 {
     app_config->desktop_sort_by = gtk_radio_action_get_current_value(cur);
-    gtk_tree_sortable_set_sort_column_id(GTK_TREE_SORTABLE(desktop->model),
+    if(!desktop_model)
+        return;
+    gtk_tree_sortable_set_sort_column_id(GTK_TREE_SORTABLE(desktop_model),
                                          app_config->desktop_sort_by,
                                          app_config->desktop_sort_type);
 }
@@ -2312,12 +2351,19 @@ static void on_open_folder_in_terminal(GtkAction* act, gpointer user_data)
 {
     FmFileMenu* menu = (FmFileMenu*)user_data;
     FmFileInfoList* files = fm_file_menu_get_file_info_list(menu);
+    GList* dirs = NULL;
     GList* l;
     for(l=fm_file_info_list_peek_head_link(files);l;l=l->next)
     {
         FmFileInfo* fi = (FmFileInfo*)l->data;
         if(fm_file_info_is_dir(fi) /*&& !fm_file_info_is_virtual(fi)*/)
-            pcmanfm_open_folder_in_terminal(NULL, fm_file_info_get_path(fi));
+            dirs = g_list_prepend(dirs, fm_file_info_get_path(fi));
+    }
+    if(dirs)
+    {
+        dirs = g_list_reverse(dirs);
+        pcmanfm_open_folders_in_terminal(NULL, dirs);
+        g_list_free(dirs);
     }
 }
 
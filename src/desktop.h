@@ -78,7 +78,6 @@ struct _FmDesktop
     guint single_click_timeout_handler;
     FmFolderModel* model;
     FmBackgroundCache* wallpapers;
-    GtkMenu* popup;
     uint cur_desktop;
 };
 
@@ -0,0 +1,286 @@
+/*
+ *      dir-history.c: folders visited in all sessions, ranked by frecency
+ *
+ *      Copyright 2012 Hong Jen Yee (PCMan) <pcman.tw@gmail.com>
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "dir-history.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* File format: one folder per line, "visits last_visit path\n". */
+
+#define MAX_ITEMS 1000
+/* delay before writing changes to disk, in seconds */
+#define SAVE_DELAY 10
+
+typedef struct
+{
+    char* path_str; /* as returned by fm_path_to_str() */
+    char* key; /* casefolded path_str used for matching */
+    const char* name_key; /* basename part of key */
+    guint visits;
+    glong last_visit;
+    gdouble score; /* temporary used for sorting */
+}DirItem;
+
+static GHashTable* items = NULL; /* path_str -> DirItem */
+static gboolean dirty = FALSE;
+static guint save_handler = 0;
+
+static glong get_now(void)
+{
+    GTimeVal now;
+    g_get_current_time(&now);
+    return now.tv_sec;
+}
+
+static char* get_history_file(gboolean create_dir)
+{
+    char* dir = g_build_filename(g_get_user_cache_dir(), "pcmanfm", NULL);
+    char* file = NULL;
+    if(!create_dir || g_mkdir_with_parents(dir, 0700) == 0)
+        file = g_build_filename(dir, "dir-history", NULL);
+    g_free(dir);
+    return file;
+}
+
+static void dir_item_free(DirItem* item)
+{
+    g_free(item->path_str);
+    g_free(item->key);
+    g_slice_free(DirItem, item);
+}
+
+static DirItem* add_item(char* path_str, guint visits, glong last_visit)
+{
+    DirItem* item = g_slice_new(DirItem);
+    char* slash;
+    item->path_str = path_str;
+    item->key = g_utf8_casefold(path_str, -1);
+    slash = strrchr(item->key, '/');
+    /* "/" and "sftp://host/" are matched by full name */
+    item->name_key = (slash && slash[1]) ? slash + 1 : item->key;
+    item->visits = visits;
+    item->last_visit = last_visit;
+    item->score = 0;
+    g_hash_table_replace(items, path_str, item);
+    return item;
+}
+
+static void load_history(void)
+{
+    char* file;
+    char* data;
+    char *line, *eol;
+
+    items = g_hash_table_new_full(g_str_hash, g_str_equal, NULL,
+                                  (GDestroyNotify)dir_item_free);
+    file = get_history_file(FALSE);
+    if(g_file_get_contents(file, &data, NULL, NULL))
+    {
+        for(line = data; *line; line = eol)
+        {
+            guint visits;
+            glong last_visit;
+            char* path_str;
+
+            eol = strchr(line, '\n');
+            if(eol)
+                *eol++ = '\0';
+            else
+                eol = line + strlen(line);
+            visits = strtoul(line, &line, 10);
+            last_visit = strtol(line, &line, 10);
+            if(*line != ' ' || line[1] == '\0' || visits == 0)
+                continue; /* broken line */
+            path_str = line + 1;
+            if(g_hash_table_lookup(items, path_str) == NULL)
+                add_item(g_strdup(path_str), visits, last_visit);
+        }
+        g_free(data);
+    }
+    g_free(file);
+}
+
+/* visits are worth less as time goes */
+static inline gdouble get_score(DirItem* item, glong now)
+{
+    glong age = now - item->last_visit;
+    gdouble weight;
+    if(age < 4 * 3600)
+        weight = 4;
+    else if(age < 24 * 3600)
+        weight = 2;
+    else if(age < 7 * 24 * 3600)
+        weight = 1;
+    else if(age < 30 * 24 * 3600)
+        weight = 0.5;
+    else
+        weight = 0.25;
+    return item->visits * weight;
+}
+
+static gint compare_score(gconstpointer a, gconstpointer b)
+{
+    gdouble sa = ((DirItem*)a)->score, sb = ((DirItem*)b)->score;
+    return sa < sb ? 1 : (sa > sb ? -1 : 0);
+}
+
+/* drop folders which are least likely to be used again */
+static void prune_history(void)
+{
+    GList* all = g_hash_table_get_values(items);
+    GList* l;
+    glong now = get_now();
+    guint n;
+
+    for(l = all; l; l = l->next)
+        ((DirItem*)l->data)->score = get_score((DirItem*)l->data, now);
+    all = g_list_sort(all, compare_score);
+    for(n = 0, l = all; l; l = l->next, ++n)
+        if(n >= MAX_ITEMS)
+            g_hash_table_remove(items, ((DirItem*)l->data)->path_str);
+    g_list_free(all);
+}
+
+static gboolean on_save_timeout(gpointer user_data)
+{
+    save_handler = 0;
+    pcmanfm_dir_history_save();
+    return FALSE;
+}
+
+void pcmanfm_dir_history_add(FmPath* path)
+{
+    char* path_str;
+    DirItem* item;
+
+    if(G_UNLIKELY(!items))
+        load_history();
+    path_str = fm_path_to_str(path);
+    item = (DirItem*)g_hash_table_lookup(items, path_str);
+    if(item)
+    {
+        g_free(path_str);
+        item->visits++;
+        item->last_visit = get_now();
+    }
+    else
+    {
+        add_item(path_str, 1, get_now());
+        /* prune in steps, not on every new folder */
+        if(g_hash_table_size(items) > MAX_ITEMS + MAX_ITEMS / 10)
+            prune_history();
+    }
+    dirty = TRUE;
+    if(!save_handler)
+        save_handler = g_timeout_add_seconds(SAVE_DELAY, on_save_timeout, NULL);
+}
+
+/* 0 if not matched, otherwise smaller is better */
+static inline int match_item(DirItem* item, const char* key)
+{
+    const char* p;
+    if(g_str_has_prefix(item->name_key, key))
+        return 1;
+    if(strstr(item->key, key))
+        return 2;
+    /* all characters of key are found in the same order */
+    for(p = item->key; *key; ++key)
+    {
+        p = strchr(p, *key);
+        if(!p)
+            return 0;
+        ++p;
+    }
+    return 3;
+}
+
+GList* pcmanfm_dir_history_match(const char* text, guint max_items)
+{
+    GList* found = NULL;
+    GList* l;
+    GList* paths = NULL;
+    GHashTableIter it;
+    DirItem* item;
+    char* key;
+    glong now = get_now();
+
+    if(G_UNLIKELY(!items))
+        load_history();
+    key = g_utf8_casefold(text, -1);
+    g_hash_table_iter_init(&it, items);
+    while(g_hash_table_iter_next(&it, NULL, (gpointer*)&item))
+    {
+        int level = *key ? match_item(item, key) : 1;
+        if(level == 0)
+            continue;
+        /* any match of better level beats a more used folder */
+        item->score = get_score(item, now) - level * 1e6;
+        found = g_list_prepend(found, item);
+    }
+    g_free(key);
+    found = g_list_sort(found, compare_score);
+    for(l = found; l && max_items > 0; l = l->next, --max_items)
+    {
+        item = (DirItem*)l->data;
+        paths = g_list_prepend(paths, fm_path_new_for_str(item->path_str));
+    }
+    g_list_free(found);
+    return g_list_reverse(paths);
+}
+
+void pcmanfm_dir_history_free_list(GList* paths)
+{
+    g_list_foreach(paths, (GFunc)fm_path_unref, NULL);
+    g_list_free(paths);
+}
+
+void pcmanfm_dir_history_save(void)
+{
+    GString* buf;
+    GHashTableIter it;
+    DirItem* item;
+    char* file;
+
+    if(save_handler)
+    {
+        g_source_remove(save_handler);
+        save_handler = 0;
+    }
+    if(!dirty)
+        return;
+    dirty = FALSE;
+    file = get_history_file(TRUE);
+    if(!file)
+        return;
+    buf = g_string_sized_new(g_hash_table_size(items) * 64);
+    g_hash_table_iter_init(&it, items);
+    while(g_hash_table_iter_next(&it, NULL, (gpointer*)&item))
+        g_string_append_printf(buf, "%u %ld %s\n", item->visits,
+                               item->last_visit, item->path_str);
+    g_file_set_contents(file, buf->str, buf->len, NULL);
+    g_string_free(buf, TRUE);
+    g_free(file);
+}
@@ -0,0 +1,48 @@
+/*
+ *      dir-history.h: folders visited in all sessions, ranked by frecency
+ *
+ *      Copyright 2012 Hong Jen Yee (PCMan) <pcman.tw@gmail.com>
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#ifndef __DIR_HISTORY_H__
+#define __DIR_HISTORY_H__
+
+#include <libfm/fm-gtk.h>
+
+G_BEGIN_DECLS
+
+/* Unlike FmNavHistory of each tab, this history is shared by all windows
+ * and kept between sessions in user cache dir. Folders are ranked by
+ * number of visits weighted by how recent the last visit was. */
+
+/* remember that the user visited the folder */
+void pcmanfm_dir_history_add(FmPath* path);
+
+/* find up to max_items folders which match the text, best ones first.
+ * Folders whose name starts with the text come first, then ones which
+ * contain it, then ones which contain its characters in the same order.
+ * Returned list of FmPath* should be freed with pcmanfm_dir_history_free_list() */
+GList* pcmanfm_dir_history_match(const char* text, guint max_items);
+void pcmanfm_dir_history_free_list(GList* paths);
+
+/* write the history to disk if it was changed */
+void pcmanfm_dir_history_save(void);
+
+G_END_DECLS
+
+#endif
@@ -0,0 +1,343 @@
+/*
+ *      folder-snapshot.c: persistent listings of remote folders
+ *
+ *      Copyright 2012 Hong Jen Yee (PCMan) <pcman.tw@gmail.com>
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "folder-snapshot.h"
+
+#include <string.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <glib/gstdio.h>
+
+/* File format (native byte order, the cache is not shared between hosts):
+ *   magic "PCMFSNAP", guint32 version, guint32 number of files,
+ *   then for each file:
+ *   guint32 mode, guint8 flags, guint64 size, gint64 mtime,
+ *   and strings name, display name, mime type, each as guint16 length
+ *   followed by bytes without terminating zero. */
+
+#define SNAPSHOT_MAGIC "PCMFSNAP"
+#define SNAPSHOT_VERSION 1
+
+/* don't save very big folders */
+#define MAX_SNAPSHOT_FILES 100000
+
+/* snapshots not updated for this long are deleted, in seconds */
+#define MAX_SNAPSHOT_AGE (30 * 24 * 60 * 60)
+/* maximum number of kept snapshots, the oldest are deleted */
+#define MAX_SNAPSHOTS 500
+
+enum
+{
+    SNAPSHOT_IS_DIR = 1 << 0,
+    SNAPSHOT_IS_HIDDEN = 1 << 1
+};
+
+gboolean pcmanfm_folder_snapshot_is_wanted(FmPath* path)
+{
+    /* local folders are fast enough, virtual ones are not real listings */
+    return !fm_path_is_native(path) && !fm_path_is_virtual(path);
+}
+
+static inline char* get_snapshot_dir(void)
+{
+    return g_build_filename(g_get_user_cache_dir(), "pcmanfm", "listings", NULL);
+}
+
+static char* get_snapshot_file(FmPath* path, gboolean create_dir)
+{
+    char* uri = fm_path_to_uri(path);
+    char* name = g_compute_checksum_for_string(G_CHECKSUM_MD5, uri, -1);
+    char* dir = get_snapshot_dir();
+    char* file = NULL;
+
+    g_free(uri);
+    if(!create_dir || g_mkdir_with_parents(dir, 0700) == 0)
+        file = g_build_filename(dir, name, NULL);
+    g_free(dir);
+    g_free(name);
+    return file;
+}
+
+static inline void append_str(GString* buf, const char* str)
+{
+    gsize len = str ? strlen(str) : 0;
+    guint16 len16;
+    if(len > G_MAXUINT16)
+        len = G_MAXUINT16;
+    len16 = len;
+    g_string_append_len(buf, (const char*)&len16, sizeof(len16));
+    g_string_append_len(buf, str, len);
+}
+
+static void on_snapshot_saved(GObject* src, GAsyncResult* res, gpointer user_data)
+{
+    g_file_replace_contents_finish(G_FILE(src), res, NULL, NULL);
+    g_free(user_data);
+}
+
+typedef struct
+{
+    char* file;
+    time_t mtime;
+}SnapshotFile;
+
+static gint compare_snapshot_age(gconstpointer a, gconstpointer b)
+{
+    const SnapshotFile* sa = (const SnapshotFile*)a;
+    const SnapshotFile* sb = (const SnapshotFile*)b;
+    /* newest first */
+    return sa->mtime < sb->mtime ? 1 : (sa->mtime > sb->mtime ? -1 : 0);
+}
+
+/* runs in a worker thread, deletes old snapshots */
+static gboolean prune_snapshots(GIOSchedulerJob* job, GCancellable* cancellable, gpointer user_data)
+{
+    char* dir_path = get_snapshot_dir();
+    GDir* dir = g_dir_open(dir_path, 0, NULL);
+    GArray* files;
+    const char* name;
+    time_t now = time(NULL);
+    guint i;
+
+    if(!dir)
+    {
+        g_free(dir_path);
+        return FALSE;
+    }
+    files = g_array_new(FALSE, FALSE, sizeof(SnapshotFile));
+    while((name = g_dir_read_name(dir)))
+    {
+        SnapshotFile sf;
+        struct stat st;
+        sf.file = g_build_filename(dir_path, name, NULL);
+        if(g_stat(sf.file, &st) == 0 && now - st.st_mtime < MAX_SNAPSHOT_AGE)
+        {
+            sf.mtime = st.st_mtime;
+            g_array_append_val(files, sf);
+        }
+        else
+        {
+            g_unlink(sf.file);
+            g_free(sf.file);
+        }
+    }
+    g_dir_close(dir);
+    g_free(dir_path);
+
+    if(files->len > MAX_SNAPSHOTS)
+        g_array_sort(files, compare_snapshot_age);
+    for(i = 0; i < files->len; ++i)
+    {
+        SnapshotFile* sf = &g_array_index(files, SnapshotFile, i);
+        if(i >= MAX_SNAPSHOTS)
+            g_unlink(sf->file);
+        g_free(sf->file);
+    }
+    g_array_free(files, TRUE);
+    return FALSE;
+}
+
+void pcmanfm_folder_snapshot_save(FmFolder* folder)
+{
+    static gboolean pruned = FALSE;
+    FmFileInfoList* files = fm_folder_get_files(folder);
+    guint32 n = fm_file_info_list_get_length(files);
+    guint32 version = SNAPSHOT_VERSION;
+    char* path_str;
+    GString* buf;
+    GList* l;
+    GFile* gf;
+    gsize len;
+
+    if(n > MAX_SNAPSHOT_FILES)
+        return;
+    path_str = get_snapshot_file(fm_folder_get_path(folder), TRUE);
+    if(!path_str)
+        return;
+    /* clean up the cache once per session when it's going to grow */
+    if(!pruned)
+    {
+        pruned = TRUE;
+        g_io_scheduler_push_job(prune_snapshots, NULL, NULL, G_PRIORITY_LOW, NULL);
+    }
+
+    buf = g_string_sized_new(64 + n * 64);
+    g_string_append_len(buf, SNAPSHOT_MAGIC, 8);
+    g_string_append_len(buf, (const char*)&version, sizeof(version));
+    g_string_append_len(buf, (const char*)&n, sizeof(n));
+    for(l = fm_file_info_list_peek_head_link(files); l; l = l->next)
+    {
+        FmFileInfo* fi = (FmFileInfo*)l->data;
+        FmMimeType* mime_type = fm_file_info_get_mime_type(fi);
+        guint32 mode = fm_file_info_get_mode(fi);
+        guint8 flags = 0;
+        guint64 size = fm_file_info_get_size(fi);
+        gint64 mtime = fm_file_info_get_mtime(fi);
+
+        if(fm_file_info_is_dir(fi))
+            flags |= SNAPSHOT_IS_DIR;
+        if(fm_file_info_is_hidden(fi))
+            flags |= SNAPSHOT_IS_HIDDEN;
+        g_string_append_len(buf, (const char*)&mode, sizeof(mode));
+        g_string_append_len(buf, (const char*)&flags, sizeof(flags));
+        g_string_append_len(buf, (const char*)&size, sizeof(size));
+        g_string_append_len(buf, (const char*)&mtime, sizeof(mtime));
+        append_str(buf, fm_path_get_basename(fm_file_info_get_path(fi)));
+        append_str(buf, fm_file_info_get_disp_name(fi));
+        append_str(buf, mime_type ? fm_mime_type_get_type(mime_type) : NULL);
+    }
+
+    /* write it in background, the buffer is freed when done */
+    gf = g_file_new_for_path(path_str);
+    g_free(path_str);
+    len = buf->len;
+    path_str = g_string_free(buf, FALSE);
+    g_file_replace_contents_async(gf, path_str, len, NULL, FALSE,
+                                  G_FILE_CREATE_NONE, NULL,
+                                  on_snapshot_saved, path_str);
+    g_object_unref(gf);
+}
+
+/* reads next string, returns newly allocated string or NULL if data is broken */
+static char* read_str(const char** p, const char* end)
+{
+    guint16 len;
+    char* str;
+    if(*p + sizeof(len) > end)
+        return NULL;
+    memcpy(&len, *p, sizeof(len));
+    *p += sizeof(len);
+    if(*p + len > end)
+        return NULL;
+    str = g_strndup(*p, len);
+    *p += len;
+    return str;
+}
+
+static FmFileInfo* read_file_info(FmPath* dir, const char** p, const char* end)
+{
+    guint32 mode;
+    guint8 flags;
+    guint64 size;
+    gint64 mtime;
+    char *name, *disp_name, *mime;
+    FmFileInfo* fi = NULL;
+
+    if(*p + sizeof(mode) + sizeof(flags) + sizeof(size) + sizeof(mtime) > end)
+        return NULL;
+    memcpy(&mode, *p, sizeof(mode));
+    *p += sizeof(mode);
+    memcpy(&flags, *p, sizeof(flags));
+    *p += sizeof(flags);
+    memcpy(&size, *p, sizeof(size));
+    *p += sizeof(size);
+    memcpy(&mtime, *p, sizeof(mtime));
+    *p += sizeof(mtime);
+    name = read_str(p, end);
+    disp_name = read_str(p, end);
+    mime = read_str(p, end);
+    if(name && *name && disp_name && mime)
+    {
+        GFileInfo* inf = g_file_info_new();
+        GTimeVal tv;
+
+        g_file_info_set_name(inf, name);
+        g_file_info_set_display_name(inf, disp_name);
+        g_file_info_set_file_type(inf, (flags & SNAPSHOT_IS_DIR) ? G_FILE_TYPE_DIRECTORY : G_FILE_TYPE_REGULAR);
+        g_file_info_set_is_hidden(inf, (flags & SNAPSHOT_IS_HIDDEN) != 0);
+        g_file_info_set_size(inf, size);
+        tv.tv_sec = mtime;
+        tv.tv_usec = 0;
+        g_file_info_set_modification_time(inf, &tv);
+        g_file_info_set_attribute_uint32(inf, G_FILE_ATTRIBUTE_UNIX_MODE, mode);
+        if(*mime)
+        {
+            GIcon* icon = g_content_type_get_icon(mime);
+            g_file_info_set_content_type(inf, mime);
+            g_file_info_set_icon(inf, icon);
+            g_object_unref(icon);
+        }
+        fi = fm_file_info_new_from_gfileinfo(dir, inf);
+        g_object_unref(inf);
+    }
+    g_free(name);
+    g_free(disp_name);
+    g_free(mime);
+    return fi;
+}
+
+FmFolderModel* pcmanfm_folder_snapshot_load(FmFolder* folder, gboolean show_hidden)
+{
+    FmPath* dir = fm_folder_get_path(folder);
+    FmFolderModel* model;
+    char* path_str;
+    char* data;
+    const char *p, *end;
+    gsize len;
+    guint32 version, n;
+
+    /* the folder already has some files, snapshot would duplicate them */
+    if(!fm_list_is_empty(fm_folder_get_files(folder)))
+        return NULL;
+    path_str = get_snapshot_file(dir, FALSE);
+    if(!g_file_get_contents(path_str, &data, &len, NULL))
+    {
+        g_free(path_str);
+        return NULL;
+    }
+    g_free(path_str);
+
+    p = data;
+    end = data + len;
+    if(len < 16 || memcmp(p, SNAPSHOT_MAGIC, 8) != 0)
+    {
+        g_free(data);
+        return NULL;
+    }
+    memcpy(&version, p + 8, sizeof(version));
+    memcpy(&n, p + 12, sizeof(n));
+    p += 16;
+    if(version != SNAPSHOT_VERSION || n > MAX_SNAPSHOT_FILES)
+    {
+        g_free(data);
+        return NULL;
+    }
+
+    model = fm_folder_model_new(folder, show_hidden);
+    /* the model should show the snapshot only, not files being loaded */
+    g_signal_handlers_disconnect_matched(folder, G_SIGNAL_MATCH_DATA,
+                                         0, 0, NULL, NULL, model);
+    for(; n > 0; --n)
+    {
+        FmFileInfo* fi = read_file_info(dir, &p, end);
+        if(!fi) /* broken file */
+            break;
+        fm_folder_model_file_created(model, fi);
+        fm_file_info_unref(fi);
+    }
+    g_free(data);
+    return model;
+}
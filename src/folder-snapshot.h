@@ -0,0 +1,45 @@
+/*
+ *      folder-snapshot.h: persistent listings of remote folders
+ *
+ *      Copyright 2012 Hong Jen Yee (PCMan) <pcman.tw@gmail.com>
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#ifndef __FOLDER_SNAPSHOT_H__
+#define __FOLDER_SNAPSHOT_H__
+
+#include <libfm/fm-gtk.h>
+
+G_BEGIN_DECLS
+
+/* Listing of a remote folder is saved in user cache dir after it is
+ * loaded, so next time the folder is entered the old listing can be
+ * shown at once while the real one is still loading. */
+
+/* check if snapshots are used for the folder */
+gboolean pcmanfm_folder_snapshot_is_wanted(FmPath* path);
+
+/* save current listing of loaded folder */
+void pcmanfm_folder_snapshot_save(FmFolder* folder);
+
+/* create a model with the saved listing of folder, the model is not
+ * updated by the folder. Returns NULL if there is no snapshot. */
+FmFolderModel* pcmanfm_folder_snapshot_load(FmFolder* folder, gboolean show_hidden);
+
+G_END_DECLS
+
+#endif
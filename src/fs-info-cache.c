@@ -0,0 +1,236 @@
+/*
+ *      fs-info-cache.c: free space of file systems shared by all tabs
+ *
+ *      Copyright 2012 Hong Jen Yee (PCMan) <pcman.tw@gmail.com>
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "fs-info-cache.h"
+
+#include <string.h>
+
+/* cached values are valid for this time, in seconds */
+#define FS_INFO_TTL 30
+/* outdated values are not queried more often than this */
+#define FS_INFO_MIN_INTERVAL 2
+/* consider the query lost if there is no answer for this long */
+#define FS_INFO_QUERY_TIMEOUT 10
+
+typedef struct
+{
+    guint64 total;
+    guint64 free;
+    glong updated; /* time of last values */
+    glong queried; /* time of last query */
+    gboolean valid;
+    gboolean stale; /* files were changed since last update */
+    gboolean pending; /* query is running */
+}FsInfo;
+
+typedef struct
+{
+    PcmanfmFsInfoNotify func;
+    gpointer user_data;
+}FsInfoNotify;
+
+static GHashTable* fs_infos = NULL; /* file system key -> FsInfo */
+static GSList* notifies = NULL;
+
+static glong get_now(void)
+{
+    GTimeVal now;
+    g_get_current_time(&now);
+    return now.tv_sec;
+}
+
+/* remote folders are identified by root of their mount, a server can
+ * export several shares like smb://host/share1/ and smb://host/share2/.
+ * The mounts are only listed from the volume monitor, no I/O is done.
+ * Returns NULL if the folder is not mounted through GIO. */
+static char* get_mount_key(FmPath* path)
+{
+    GFile* gf = fm_path_to_gfile(path);
+    GVolumeMonitor* mon = g_volume_monitor_get();
+    GList* mounts = g_volume_monitor_get_mounts(mon);
+    GList* l;
+    char* key = NULL;
+    gsize key_len = 0;
+
+    for(l = mounts; l; l = l->next)
+    {
+        GMount* mount = G_MOUNT(l->data);
+        GFile* root = g_mount_get_root(mount);
+        if(g_file_equal(root, gf) || g_file_has_prefix(gf, root))
+        {
+            char* uri = g_file_get_uri(root);
+            /* nested mounts: the innermost one is the right one */
+            if(strlen(uri) > key_len)
+            {
+                g_free(key);
+                key = uri;
+                key_len = strlen(uri);
+            }
+            else
+                g_free(uri);
+        }
+        g_object_unref(root);
+        g_object_unref(mount);
+    }
+    g_list_free(mounts);
+    g_object_unref(mon);
+    g_object_unref(gf);
+    return key;
+}
+
+/* native folders are identified by device number, others by their mount
+ * since a statfs may need a network round trip.
+ * The device is taken from info of the loaded folder so we never do
+ * any I/O here, a hung mount would block the UI otherwise. */
+static char* get_fs_key(FmFolder* folder)
+{
+    FmPath* path = fm_folder_get_path(folder);
+    FmPath* parent;
+    char* key;
+    if(fm_path_is_native(path))
+    {
+        FmFileInfo* fi = fm_folder_get_info(folder);
+        if(!fi) /* not loaded yet */
+            return NULL;
+        return g_strdup_printf("dev:%lx", (gulong)fm_file_info_get_dev(fi));
+    }
+    /* the key is looked up on each status update, find it only once */
+    key = (char*)g_object_get_data(G_OBJECT(folder), "pcmanfm-fs-key");
+    if(key)
+        return g_strdup(key);
+    key = get_mount_key(path);
+    if(key)
+    {
+        g_object_set_data_full(G_OBJECT(folder), "pcmanfm-fs-key", key, g_free);
+        return g_strdup(key);
+    }
+    /* use the first path element after the host as a share name,
+     * like smb://host/share */
+    while((parent = fm_path_get_parent(path)) && fm_path_get_parent(parent))
+        path = parent;
+    return fm_path_to_str(path);
+}
+
+static FsInfo* lookup_fs_info(FmFolder* folder, gboolean create)
+{
+    char* key = get_fs_key(folder);
+    FsInfo* info;
+
+    if(!key)
+        return NULL;
+    if(G_UNLIKELY(!fs_infos))
+        fs_infos = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    info = (FsInfo*)g_hash_table_lookup(fs_infos, key);
+    if(!info && create)
+    {
+        info = g_new0(FsInfo, 1);
+        g_hash_table_insert(fs_infos, key, info);
+        return info;
+    }
+    g_free(key);
+    return info;
+}
+
+gboolean pcmanfm_fs_info_get(FmFolder* folder, guint64* total, guint64* free)
+{
+    FsInfo* info = lookup_fs_info(folder, FALSE);
+    if(!info || !info->valid)
+        return FALSE;
+    *total = info->total;
+    *free = info->free;
+    return TRUE;
+}
+
+void pcmanfm_fs_info_query(FmFolder* folder)
+{
+    FsInfo* info = lookup_fs_info(folder, TRUE);
+    glong now = get_now();
+
+    if(info)
+    {
+        if(info->pending && now - info->queried < FS_INFO_QUERY_TIMEOUT)
+            return; /* some other folder will get it for us */
+        if(info->valid && now - info->updated < FS_INFO_TTL
+           && (!info->stale || now - info->queried < FS_INFO_MIN_INTERVAL))
+            return;
+        info->pending = TRUE;
+        info->queried = now;
+    }
+    fm_folder_query_filesystem_info(folder);
+}
+
+void pcmanfm_fs_info_update(FmFolder* folder)
+{
+    FsInfo* info;
+    guint64 total, free;
+    GSList* l;
+
+    if(!fm_folder_get_filesystem_info(folder, &total, &free))
+        return;
+    info = lookup_fs_info(folder, TRUE);
+    if(!info)
+        return;
+    info->total = total;
+    info->free = free;
+    info->updated = get_now();
+    info->valid = TRUE;
+    info->stale = FALSE;
+    info->pending = FALSE;
+    for(l = notifies; l; l = l->next)
+    {
+        FsInfoNotify* n = (FsInfoNotify*)l->data;
+        n->func(n->user_data);
+    }
+}
+
+void pcmanfm_fs_info_invalidate(FmFolder* folder)
+{
+    FsInfo* info = lookup_fs_info(folder, FALSE);
+    if(info)
+        info->stale = TRUE;
+}
+
+void pcmanfm_fs_info_add_notify(PcmanfmFsInfoNotify func, gpointer user_data)
+{
+    FsInfoNotify* n = g_slice_new(FsInfoNotify);
+    n->func = func;
+    n->user_data = user_data;
+    notifies = g_slist_prepend(notifies, n);
+}
+
+void pcmanfm_fs_info_remove_notify(PcmanfmFsInfoNotify func, gpointer user_data)
+{
+    GSList* l;
+    for(l = notifies; l; l = l->next)
+    {
+        FsInfoNotify* n = (FsInfoNotify*)l->data;
+        if(n->func == func && n->user_data == user_data)
+        {
+            notifies = g_slist_delete_link(notifies, l);
+            g_slice_free(FsInfoNotify, n);
+            break;
+        }
+    }
+}
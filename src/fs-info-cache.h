@@ -0,0 +1,53 @@
+/*
+ *      fs-info-cache.h: free space of file systems shared by all tabs
+ *
+ *      Copyright 2012 Hong Jen Yee (PCMan) <pcman.tw@gmail.com>
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#ifndef __FS_INFO_CACHE_H__
+#define __FS_INFO_CACHE_H__
+
+#include <libfm/fm-gtk.h>
+
+G_BEGIN_DECLS
+
+/* Free space is kept per file system, so folders on the same mount
+ * don't query it each one separately. The values are refreshed when
+ * they are too old or after files on the file system were changed. */
+
+typedef void (*PcmanfmFsInfoNotify)(gpointer user_data);
+
+/* get cached free space of file system containing the folder */
+gboolean pcmanfm_fs_info_get(FmFolder* folder, guint64* total, guint64* free);
+
+/* query free space for the folder if the cached values are not valid */
+void pcmanfm_fs_info_query(FmFolder* folder);
+
+/* remember free space reported by the folder, called on "fs-info" */
+void pcmanfm_fs_info_update(FmFolder* folder);
+
+/* mark cached values for the file system containing the folder as outdated */
+void pcmanfm_fs_info_invalidate(FmFolder* folder);
+
+/* the notify is called each time some cached values are updated */
+void pcmanfm_fs_info_add_notify(PcmanfmFsInfoNotify func, gpointer user_data);
+void pcmanfm_fs_info_remove_notify(PcmanfmFsInfoNotify func, gpointer user_data);
+
+G_END_DECLS
+
+#endif
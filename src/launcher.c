@@ -0,0 +1,108 @@
+/*
+ *      launcher.c: starting of external programs
+ *
+ *      Copyright 2012 Hong Jen Yee (PCMan) <pcman.tw@gmail.com>
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include "launcher.h"
+
+#include <string.h>
+
+extern char** environ;
+
+static void on_child_exit(GPid pid, gint status, gpointer user_data)
+{
+    g_spawn_close_pid(pid);
+}
+
+/* copy of our environment without the variables set for each child,
+ * with two free slots left at the end for them */
+static char** make_envp(guint* n_envp)
+{
+    guint n = environ ? g_strv_length(environ) : 0;
+    char** envp = g_new(char*, n + 3);
+    guint i, j = 0;
+
+    for(i = 0; i < n; ++i)
+        if(strncmp(environ[i], "DISPLAY=", 8) != 0
+           && strncmp(environ[i], "DESKTOP_STARTUP_ID=", 19) != 0)
+            envp[j++] = g_strdup(environ[i]);
+    envp[j] = NULL;
+    *n_envp = j;
+    return envp;
+}
+
+guint pcmanfm_launch_in_dirs(GAppLaunchContext* ctx, char** argv,
+                             const char* const* dirs, GError** err)
+{
+    GAppInfo* app;
+    char** envp;
+    char* display;
+    guint n_envp, n = 0;
+
+    /* used for startup notification only */
+    app = g_app_info_create_from_commandline(argv[0], NULL,
+                    G_APP_INFO_CREATE_SUPPORTS_STARTUP_NOTIFICATION, NULL);
+    /* it's the same for all the children so build it once */
+    envp = make_envp(&n_envp);
+    display = app ? g_app_launch_context_get_display(ctx, app, NULL) : NULL;
+    if(display)
+    {
+        envp[n_envp++] = g_strconcat("DISPLAY=", display, NULL);
+        envp[n_envp] = NULL;
+        g_free(display);
+    }
+    for(; *dirs; ++dirs)
+    {
+        GPid pid;
+        GError* error = NULL;
+        char* sn_id = app ? g_app_launch_context_get_startup_notify_id(ctx, app, NULL) : NULL;
+
+        envp[n_envp] = sn_id ? g_strconcat("DESKTOP_STARTUP_ID=", sn_id, NULL) : NULL;
+        envp[n_envp + 1] = NULL;
+        /* the child does chdir() after fork, our cwd stays untouched.
+         * We don't let GLib wait for the child, it's reaped in main loop. */
+        if(g_spawn_async(*dirs, argv, envp,
+                         G_SPAWN_SEARCH_PATH | G_SPAWN_DO_NOT_REAP_CHILD,
+                         NULL, NULL, &pid, &error))
+        {
+            g_child_watch_add(pid, on_child_exit, NULL);
+            ++n;
+        }
+        else
+        {
+            if(sn_id)
+                g_app_launch_context_launch_failed(ctx, sn_id);
+            if(err && !*err)
+                g_propagate_error(err, error);
+            else
+                g_error_free(error);
+        }
+        g_free(envp[n_envp]);
+        envp[n_envp] = NULL;
+        g_free(sn_id);
+    }
+    g_strfreev(envp);
+    if(app)
+        g_object_unref(app);
+    return n;
+}
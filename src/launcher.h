@@ -0,0 +1,42 @@
+/*
+ *      launcher.h: starting of external programs
+ *
+ *      Copyright 2012 Hong Jen Yee (PCMan) <pcman.tw@gmail.com>
+ *
+ *      This program is free software; you can redistribute it and/or modify
+ *      it under the terms of the GNU General Public License as published by
+ *      the Free Software Foundation; either version 2 of the License, or
+ *      (at your option) any later version.
+ *
+ *      This program is distributed in the hope that it will be useful,
+ *      but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *      MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *      GNU General Public License for more details.
+ *
+ *      You should have received a copy of the GNU General Public License
+ *      along with this program; if not, write to the Free Software
+ *      Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ *      MA 02110-1301, USA.
+ */
+
+#ifndef __LAUNCHER_H__
+#define __LAUNCHER_H__
+
+#include <gtk/gtk.h>
+
+G_BEGIN_DECLS
+
+/* Programs are started with their working directory set in the child
+ * process, so current directory of pcmanfm itself is never changed.
+ * Children are reaped by the main loop, nobody waits for them. */
+
+/* run the program once in each of dirs, which is NULL-terminated array
+ * of local paths. The context gives display and startup notification.
+ * Returns number of started processes, if some failed then the first
+ * error is set. */
+guint pcmanfm_launch_in_dirs(GAppLaunchContext* ctx, char** argv,
+                             const char* const* dirs, GError** err);
+
+G_END_DECLS
+
+#endif
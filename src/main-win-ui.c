@@ -64,6 +64,8 @@ static const char main_menu_xml[] =
     "<menuitem action='Trash'/>"
     "<menuitem action='Network'/>"
     "<menuitem action='Apps'/>"
+    "<separator/>"
+    "<menuitem action='JumpTo'/>"
   "</menu>"
   "<menu action='BookmarksMenu'>"
     "<menuitem action='AddBookmark'/>"
@@ -175,6 +177,7 @@ static GtkActionEntry main_win_actions[]=
         {"Network", GTK_STOCK_NETWORK, N_("Network Drives"), NULL, NULL, G_CALLBACK(on_go_network)},
         {"Apps", "system-software-install", N_("Applications"), NULL, N_("Installed Applications"), G_CALLBACK(on_go_apps)},
         {"Go", GTK_STOCK_JUMP_TO, NULL, NULL, NULL, G_CALLBACK(on_go)},
+        {"JumpTo", GTK_STOCK_JUMP_TO, N_("_Jump to Folder..."), "<Ctrl>J", N_("Jump to a recently used folder"), G_CALLBACK(on_jump_to)},
     {"BookmarksMenu", NULL, N_("_Bookmarks"), NULL, NULL, NULL},
         {"AddBookmark", GTK_STOCK_ADD, N_("Add To Bookmarks"), NULL, NULL, G_CALLBACK(on_add_bookmark)},
     {"ToolMenu", NULL, N_("_Tools"), NULL, NULL, NULL},
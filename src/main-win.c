@@ -30,6 +30,7 @@
 #include <unistd.h> /* for get euid */
 #include <sys/types.h>
 #include <ctype.h>
+#include <string.h>
 
 #include "pcmanfm.h"
 
@@ -37,6 +38,8 @@
 #include "main-win.h"
 #include "pref.h"
 #include "tab-page.h"
+#include "utils.h"
+#include "dir-history.h"
 
 #if GTK_CHECK_VERSION(3, 0, 0)
 static void fm_main_win_destroy(GtkWidget *object);
@@ -53,6 +56,8 @@ static gboolean on_focus_in(GtkWidget* w, GdkEventFocus* evt);
 static gboolean on_key_press_event(GtkWidget* w, GdkEventKey* evt);
 static gboolean on_button_press_event(GtkWidget* w, GdkEventButton* evt);
 static void on_unrealize(GtkWidget* widget);
+static gboolean on_configure_event(GtkWidget* widget, GdkEventConfigure* evt);
+static gboolean on_window_state_event(GtkWidget* widget, GdkEventWindowState* evt);
 
 static void on_new_win(GtkAction* act, FmMainWin* win);
 static void on_new_tab(GtkAction* act, FmMainWin* win);
@@ -86,6 +91,7 @@ static void on_go_trash(GtkAction* act, FmMainWin* win);
 static void on_go_computer(GtkAction* act, FmMainWin* win);
 static void on_go_network(GtkAction* act, FmMainWin* win);
 static void on_go_apps(GtkAction* act, FmMainWin* win);
+static void on_jump_to(GtkAction* act, FmMainWin* win);
 static void on_reload(GtkAction* act, FmMainWin* win);
 static void on_show_hidden(GtkToggleAction* act, FmMainWin* win);
 static void on_show_side_pane(GtkToggleAction* act, FmMainWin* win);
@@ -108,12 +114,33 @@ static void on_notebook_page_added(GtkNotebook* nb, GtkWidget* page, guint num,
 static void on_notebook_page_removed(GtkNotebook* nb, GtkWidget* page, guint num, FmMainWin* win);
 
 static void on_folder_view_clicked(FmFolderView* fv, FmFolderViewClickType type, FmFileInfo* fi, FmMainWin* win);
+static void cancel_target_job(FmMainWin* win);
 
 #include "main-win-ui.c" /* ui xml definitions and actions */
 
 static GSList* all_wins = NULL;
 static GtkDialog* about_dlg = NULL;
 
+/* pool of pre-built hidden windows, used in daemon mode */
+typedef struct
+{
+    FmMainWin* win;
+    FmTabPage* page; /* prepared but not yet added to the notebook */
+    char* config; /* settings the window was built with */
+}PooledWin;
+
+/* tabs not shown for this long are hibernated, in seconds */
+#define HIBERNATE_TIMEOUT (30 * 60)
+/* maximum number of tabs which are kept loaded */
+#define MAX_AWAKE_TABS 10
+
+static guint hibernate_handler = 0;
+
+static GSList* win_pool = NULL;
+static guint win_pool_size = 0;
+static guint win_pool_idle = 0;
+static gulong win_pool_config_handler = 0;
+
 static void fm_main_win_class_init(FmMainWinClass *klass)
 {
     GObjectClass *g_object_class = G_OBJECT_CLASS(klass);
@@ -132,6 +159,8 @@ static void fm_main_win_class_init(FmMainWinClass *klass)
     widget_class->key_press_event = on_key_press_event;
     widget_class->button_press_event = on_button_press_event;
     widget_class->unrealize = on_unrealize;
+    widget_class->configure_event = on_configure_event;
+    widget_class->window_state_event = on_window_state_event;
 
     fm_main_win_parent_class = (GtkWindowClass*)g_type_class_peek(GTK_TYPE_WINDOW);
 }
@@ -172,25 +201,39 @@ static gboolean open_folder_func(GAppLaunchContext* ctx, GList* folder_infos, gp
 {
     FmMainWin* win = FM_MAIN_WIN(user_data);
     GList* l = folder_infos;
+    GList* paths = NULL;
     FmFileInfo* fi = (FmFileInfo*)l->data;
     fm_main_win_chdir(win, fm_file_info_get_path(fi));
     l=l->next;
     for(; l; l=l->next)
     {
         FmFileInfo* fi = (FmFileInfo*)l->data;
-        fm_main_win_add_tab(win, fm_file_info_get_path(fi));
+        paths = g_list_prepend(paths, fm_file_info_get_path(fi));
+    }
+    if(paths)
+    {
+        paths = g_list_reverse(paths);
+        fm_main_win_add_tabs(win, paths);
+        g_list_free(paths);
     }
     return TRUE;
 }
 
 static FmJobErrorAction on_query_target_info_error(FmJob* job, GError* err, FmJobErrorSeverity severity, FmMainWin* win)
 {
+    /* the job got an answer, and the error dialog runs a main loop */
+    if(win->target_timeout)
+    {
+        g_source_remove(win->target_timeout);
+        win->target_timeout = 0;
+    }
     if(err->domain == G_IO_ERROR)
     {
         if(err->code == G_IO_ERROR_NOT_MOUNTED)
         {
-            if(fm_mount_path(GTK_WINDOW(win), fm_file_info_job_get_current(FM_FILE_INFO_JOB(job)), TRUE))
-                return FM_JOB_RETRY;
+            /* it's mounted in background after the job is finished */
+            g_object_set_data(G_OBJECT(job), "need-mount", GINT_TO_POINTER(TRUE));
+            return FM_JOB_CONTINUE;
         }
         else if(err->code == G_IO_ERROR_FAILED_HANDLED)
             return FM_JOB_CONTINUE;
@@ -270,8 +313,11 @@ static void on_bookmark(GtkMenuItem* mi, FmMainWin* win)
     }
 }
 
-static void create_bookmarks_menu(FmMainWin* win)
+/* update items of the menu in place, so only changed bookmarks are touched */
+static void update_bookmarks_menu(FmMainWin* win)
 {
+    GList* mis = gtk_container_get_children(GTK_CONTAINER(win->bookmarks_menu));
+    GList* ml = mis;
     GList* l;
     GtkWidget* mi;
     int i = 0;
@@ -279,44 +325,56 @@ static void create_bookmarks_menu(FmMainWin* win)
     for(l=win->bookmarks->items;l;l=l->next)
     {
         FmBookmarkItem* item = (FmBookmarkItem*)l->data;
-        mi = gtk_image_menu_item_new_with_label(item->name);
-        gtk_widget_show(mi);
-        g_object_set_data_full(G_OBJECT(mi), "path", fm_path_ref(item->path), (GDestroyNotify)fm_path_unref);
-        g_signal_connect(mi, "activate", G_CALLBACK(on_bookmark), win);
-        gtk_menu_shell_insert(win->bookmarks_menu, mi, i);
+        FmPath* path = NULL;
+        mi = ml ? (GtkWidget*)ml->data : NULL;
+        if(mi)
+            path = (FmPath*)g_object_get_data(G_OBJECT(mi), "path");
+        if(path) /* reuse old item */
+        {
+            ml = ml->next;
+            if(!fm_path_equal(path, item->path))
+                g_object_set_data_full(G_OBJECT(mi), "path", fm_path_ref(item->path), (GDestroyNotify)fm_path_unref);
+            if(g_strcmp0(gtk_menu_item_get_label(GTK_MENU_ITEM(mi)), item->name) != 0)
+                gtk_menu_item_set_label(GTK_MENU_ITEM(mi), item->name);
+        }
+        else
+        {
+            mi = gtk_image_menu_item_new_with_label(item->name);
+            gtk_widget_show(mi);
+            g_object_set_data_full(G_OBJECT(mi), "path", fm_path_ref(item->path), (GDestroyNotify)fm_path_unref);
+            g_signal_connect(mi, "activate", G_CALLBACK(on_bookmark), win);
+            gtk_menu_shell_insert(win->bookmarks_menu, mi, i);
+        }
         ++i;
     }
-    if(i > 0)
+    /* delete items of removed bookmarks */
+    for(; ml; ml = ml->next)
+    {
+        mi = (GtkWidget*)ml->data;
+        if(!g_object_get_data(G_OBJECT(mi), "path"))
+            break;
+        g_signal_handlers_disconnect_by_func(mi, on_bookmark, win);
+        gtk_widget_destroy(mi);
+    }
+    /* the separator is needed only if there are some bookmarks */
+    mi = ml ? (GtkWidget*)ml->data : NULL;
+    if(mi && GTK_IS_SEPARATOR_MENU_ITEM(mi))
+    {
+        if(i == 0)
+            gtk_widget_destroy(mi);
+    }
+    else if(i > 0)
     {
         mi = gtk_separator_menu_item_new();
         gtk_widget_show(mi);
         gtk_menu_shell_insert(win->bookmarks_menu, mi, i);
     }
+    g_list_free(mis);
 }
 
 static void on_bookmarks_changed(FmBookmarks* bm, FmMainWin* win)
 {
-    /* delete old items first. */
-    GList* mis = gtk_container_get_children(GTK_CONTAINER(win->bookmarks_menu));
-    GList* l;
-    for(l = mis;l;l=l->next)
-    {
-        GtkWidget* item = (GtkWidget*)l->data;
-        if( g_object_get_data(G_OBJECT(item), "path") )
-        {
-            g_signal_handlers_disconnect_by_func(item, on_bookmark, win);
-            gtk_widget_destroy(item);
-        }
-        else
-        {
-            if(GTK_IS_SEPARATOR_MENU_ITEM(item))
-                gtk_widget_destroy(item);
-            break;
-        }
-    }
-    g_list_free(mis);
-
-    create_bookmarks_menu(win);
+    update_bookmarks_menu(win);
 }
 
 static void load_bookmarks(FmMainWin* win, GtkUIManager* ui)
@@ -326,7 +384,7 @@ static void load_bookmarks(FmMainWin* win, GtkUIManager* ui)
     win->bookmarks = fm_bookmarks_dup();
     g_signal_connect(win->bookmarks, "changed", G_CALLBACK(on_bookmarks_changed), win);
 
-    create_bookmarks_menu(win);
+    update_bookmarks_menu(win);
 }
 
 static void on_history_item(GtkMenuItem* mi, FmMainWin* win)
@@ -336,73 +394,80 @@ static void on_history_item(GtkMenuItem* mi, FmMainWin* win)
     fm_tab_page_history(page, l);
 }
 
-static void disconnect_history_item(GtkWidget* mi, gpointer win)
-{
-    g_signal_handlers_disconnect_by_func(mi, on_history_item, win);
-    gtk_widget_destroy(mi);
-}
-
-static void on_history_selection_done(GtkMenuShell* menu, gpointer win)
-{
-    g_debug("history selection done");
-    g_signal_handlers_disconnect_by_func(menu, on_history_selection_done, NULL);
-    /* cleanup: disconnect and delete all items */
-    gtk_container_foreach(GTK_CONTAINER(menu), disconnect_history_item, win);
-}
-
+/* Items of the menu are kept after it's closed and reused next time,
+ * only labels of items which show another folder are changed. */
 static void on_show_history_menu(GtkMenuToolButton* btn, FmMainWin* win)
 {
     GtkMenuShell* menu = (GtkMenuShell*)gtk_menu_tool_button_get_menu(btn);
+    GList* mis = gtk_container_get_children(GTK_CONTAINER(menu));
+    GList* ml = mis;
     const GList* l;
     const GList* cur = fm_nav_history_get_cur_link(win->nav_history);
+    int i = 0;
 
-    /* delete old items */
-    gtk_container_foreach(GTK_CONTAINER(menu), (GtkCallback)gtk_widget_destroy, NULL);
-
-    for(l = fm_nav_history_list(win->nav_history); l; l=l->next)
+    for(l = fm_nav_history_list(win->nav_history); l; l=l->next, ++i)
     {
         const FmNavHistoryItem* item = (FmNavHistoryItem*)l->data;
         FmPath* path = item->path;
-        char* str = fm_path_display_name(path, TRUE);
-        GtkWidget* mi;
-        if( l == cur )
+        GtkWidget* mi = ml ? (GtkWidget*)ml->data : NULL;
+        gboolean is_cur = (l == cur);
+
+        if(mi && (GTK_IS_CHECK_MENU_ITEM(mi) != 0) == is_cur)
         {
-            mi = gtk_check_menu_item_new_with_label(str);
-            gtk_check_menu_item_set_draw_as_radio(GTK_CHECK_MENU_ITEM(mi), TRUE);
-            gtk_check_menu_item_set_active(GTK_CHECK_MENU_ITEM(mi), TRUE);
+            FmPath* old_path = (FmPath*)g_object_get_data(G_OBJECT(mi), "fm-path");
+            ml = ml->next;
+            if(!fm_path_equal(old_path, path))
+            {
+                char* str = fm_path_display_name(path, TRUE);
+                gtk_menu_item_set_label(GTK_MENU_ITEM(mi), str);
+                g_free(str);
+                g_object_set_data_full(G_OBJECT(mi), "fm-path", fm_path_ref(path), (GDestroyNotify)fm_path_unref);
+            }
         }
         else
-            mi = gtk_menu_item_new_with_label(str);
-        g_free(str);
-
+        {
+            char* str = fm_path_display_name(path, TRUE);
+            if(mi) /* the item of another kind, replace it */
+            {
+                ml = ml->next;
+                gtk_widget_destroy(mi);
+            }
+            if( is_cur )
+            {
+                mi = gtk_check_menu_item_new_with_label(str);
+                gtk_check_menu_item_set_draw_as_radio(GTK_CHECK_MENU_ITEM(mi), TRUE);
+                gtk_check_menu_item_set_active(GTK_CHECK_MENU_ITEM(mi), TRUE);
+            }
+            else
+                mi = gtk_menu_item_new_with_label(str);
+            g_free(str);
+            g_object_set_data_full(G_OBJECT(mi), "fm-path", fm_path_ref(path), (GDestroyNotify)fm_path_unref);
+            g_signal_connect(mi, "activate", G_CALLBACK(on_history_item), win);
+            gtk_menu_shell_insert(menu, mi, i);
+            gtk_widget_show(mi);
+        }
         /* FIXME: need to avoid cast from const GList */
         g_object_set_data_full(G_OBJECT(mi), "path", (gpointer)l, NULL);
-        g_signal_connect(mi, "activate", G_CALLBACK(on_history_item), win);
-        gtk_menu_shell_append(menu, mi);
     }
-    g_signal_connect(menu, "selection-done", G_CALLBACK(on_history_selection_done), NULL);
-    gtk_widget_show_all( GTK_WIDGET(menu) );
+    /* delete items which are not needed anymore */
+    for(; ml; ml = ml->next)
+        gtk_widget_destroy((GtkWidget*)ml->data);
+    g_list_free(mis);
 }
 
 static void on_tab_page_splitter_pos_changed(GtkPaned* paned, GParamSpec* ps, FmMainWin* win)
 {
-    GList *children, *child;
     if(paned != (GtkPaned*)win->current_page)
         return;
 
-    app_config->splitter_pos = gtk_paned_get_position(paned);
-    pcmanfm_save_config(FALSE);
-
-    /* apply the pos to all other pages as well */
+    /* other pages get the pos when they are shown, see apply_win_settings() */
     /* TODO: maybe we should allow different splitter pos for different pages later? */
-    children = gtk_container_get_children(GTK_CONTAINER(win->notebook));
-    for(child = children; child; child = child->next)
+    win->splitter_pos = gtk_paned_get_position(paned);
+    if(win->splitter_pos != app_config->splitter_pos)
     {
-        FmTabPage* page = FM_TAB_PAGE(child->data);
-        if((GtkPaned*)page != paned)
-            gtk_paned_set_position(GTK_PANED(page), app_config->splitter_pos);
+        app_config->splitter_pos = win->splitter_pos;
+        pcmanfm_save_config(FALSE);
     }
-    g_list_free(children);
 }
 
 /* This callback is only connected to side pane of current active tab page. */
@@ -420,24 +485,12 @@ static void on_side_pane_chdir(FmSidePane* sp, guint button, FmPath* path, FmMai
 /* This callback is only connected to side pane of current active tab page. */
 static void on_side_pane_mode_changed(FmSidePane* sp, FmMainWin* win)
 {
-
-    GList* children;
-    GList* child;
     FmSidePaneMode mode;
 
     if(sp != win->side_pane)
         return;
 
-    children = gtk_container_get_children(GTK_CONTAINER(win->notebook));
     mode = fm_side_pane_get_mode(sp);
-    /* set the side pane mode to all other tab pages */
-    for(child = children; child; child = child->next)
-    {
-        FmTabPage* page = FM_TAB_PAGE(child->data);
-        if(page != win->current_page)
-            fm_side_pane_set_mode(fm_tab_page_get_side_pane(page), mode);
-    }
-    g_list_free(children);
 
     /* update menu */
     gtk_radio_action_set_current_value(GTK_RADIO_ACTION(gtk_ui_manager_get_action(win->ui,
@@ -452,6 +505,77 @@ static void on_side_pane_mode_changed(FmSidePane* sp, FmMainWin* win)
     }
 }
 
+static gint compare_active_time(gconstpointer a, gconstpointer b)
+{
+    return ((FmTabPage*)b)->active_time - ((FmTabPage*)a)->active_time;
+}
+
+/* release folders of tabs not used for long time */
+static gboolean on_hibernate_timeout(gpointer user_data)
+{
+    GTimeVal now;
+    GSList* l;
+    GList *pages = NULL, *children, *child;
+    guint n_awake = 0, n_hibernated = 0;
+    gulong rss_before = 0, rss_after;
+    guint watches_before = 0, watches_after;
+
+    g_get_current_time(&now);
+    for(l = all_wins; l; l = l->next)
+    {
+        FmMainWin* win = (FmMainWin*)l->data;
+        children = gtk_container_get_children(GTK_CONTAINER(win->notebook));
+        for(child = children; child; child = child->next)
+        {
+            FmTabPage* page = FM_TAB_PAGE(child->data);
+            if(page == win->current_page)
+            {
+                page->active_time = now.tv_sec;
+                ++n_awake;
+            }
+            else if(!page->hibernated)
+                pages = g_list_prepend(pages, page);
+        }
+        g_list_free(children);
+    }
+    /* keep most recently used tabs */
+    pages = g_list_sort(pages, compare_active_time);
+    for(child = pages; child; child = child->next)
+    {
+        FmTabPage* page = (FmTabPage*)child->data;
+        if(n_awake < MAX_AWAKE_TABS
+           && now.tv_sec - page->active_time < HIBERNATE_TIMEOUT)
+        {
+            ++n_awake;
+            continue;
+        }
+        if(n_hibernated == 0 && pcmanfm_trace_is_running())
+            pcmanfm_get_resource_usage(&rss_before, &watches_before);
+        fm_tab_page_hibernate(page);
+        ++n_hibernated;
+    }
+    g_list_free(pages);
+    if(n_hibernated > 0 && pcmanfm_trace_is_running())
+    {
+        char* usage;
+        pcmanfm_get_resource_usage(&rss_after, &watches_after);
+        usage = g_strdup_printf("%u tabs: RSS %lu -> %lu KiB, inotify watches %u -> %u",
+                                n_hibernated, rss_before, rss_after,
+                                watches_before, watches_after);
+        pcmanfm_trace_mark("tabs hibernated", "usage", usage);
+        g_free(usage);
+    }
+    return TRUE;
+}
+
+/* used only for startup tracing */
+static gboolean on_first_expose(GtkWidget* w, GdkEventExpose* evt, gpointer user_data)
+{
+    g_signal_handlers_disconnect_by_func(w, on_first_expose, user_data);
+    pcmanfm_trace_mark("main window first paint", NULL, NULL);
+    return FALSE;
+}
+
 static void fm_main_win_init(FmMainWin *win)
 {
     GtkBox *vbox;
@@ -462,9 +586,12 @@ static void fm_main_win_init(FmMainWin *win)
     GtkAction* act;
     GtkAccelGroup* accel_grp;
     GtkShadowType shadow_type;
+    gint64 t = pcmanfm_trace_now();
 
     pcmanfm_ref();
     all_wins = g_slist_prepend(all_wins, win);
+    if(!hibernate_handler)
+        hibernate_handler = g_timeout_add_seconds(60, on_hibernate_timeout, NULL);
 
     /* every window should have its own window group.
      * So model dialogs opened for the window does not lockup
@@ -475,6 +602,9 @@ static void fm_main_win_init(FmMainWin *win)
 
     gtk_window_set_icon_name(GTK_WINDOW(win), "folder");
 
+    win->splitter_pos = app_config->splitter_pos;
+    win->show_hidden = app_config->show_hidden;
+
     vbox = (GtkBox*)gtk_vbox_new(FALSE, 0);
 
     /* create menu bar and toolbar */
@@ -556,6 +686,16 @@ static void fm_main_win_init(FmMainWin *win)
     gtk_tool_item_set_expand(toolitem, TRUE);
     gtk_toolbar_insert(win->toolbar, toolitem, gtk_toolbar_get_n_items(win->toolbar) - 1);
 
+    /* side pane, shared by all tabs and shown in current one */
+    win->side_pane = fm_side_pane_new();
+    g_object_ref_sink(win->side_pane);
+    fm_side_pane_set_mode(win->side_pane, app_config->side_pane_mode);
+    gtk_widget_show_all(GTK_WIDGET(win->side_pane));
+    g_signal_connect(win->side_pane, "mode-changed",
+                     G_CALLBACK(on_side_pane_mode_changed), win);
+    g_signal_connect(win->side_pane, "chdir",
+                     G_CALLBACK(on_side_pane_chdir), win);
+
     /* notebook */
     win->notebook = (GtkNotebook*)gtk_notebook_new();
     gtk_notebook_set_scrollable(win->notebook, TRUE);
@@ -591,17 +731,151 @@ static void fm_main_win_init(FmMainWin *win)
 
     gtk_container_add(GTK_CONTAINER(win), GTK_WIDGET(vbox));
     gtk_widget_show_all(GTK_WIDGET(vbox));
+
+    pcmanfm_trace_phase("fm_main_win_init", t);
+    if(pcmanfm_trace_is_running())
+        g_signal_connect_after(win, "expose-event", G_CALLBACK(on_first_expose), NULL);
 }
 
 
+static gint append_tab_page(FmMainWin* win, FmTabPage* page);
+
+/* settings which fm_main_win_init() and fm_tab_page_new() build the
+ * window with, but which are changed without "changed" signal */
+static char* get_win_pool_config(void)
+{
+    return g_strdup_printf("%d %d %d %d %d %d", app_config->show_hidden,
+                           app_config->view_mode, app_config->sort_type,
+                           app_config->sort_by, app_config->side_pane_mode,
+                           app_config->splitter_pos);
+}
+
+static void win_pool_free(PooledWin* pw)
+{
+    g_object_unref(pw->page);
+    gtk_widget_destroy(GTK_WIDGET(pw->win));
+    g_free(pw->config);
+    g_slice_free(PooledWin, pw);
+}
+
+/* takes a pre-built window from the pool, or returns NULL if it's empty */
+static FmMainWin* win_pool_pop(FmPath* path)
+{
+    PooledWin* pw;
+    FmMainWin* win;
+    char* config;
+    if(!win_pool)
+        return NULL;
+    pw = (PooledWin*)win_pool->data;
+    win_pool = g_slist_delete_link(win_pool, win_pool);
+    /* refill the pool later */
+    fm_main_win_set_pool_size(win_pool_size);
+    config = get_win_pool_config();
+    if(strcmp(config, pw->config) != 0)
+    {
+        /* menus, views and side pane would differ from a new window */
+        g_free(config);
+        win_pool_free(pw);
+        return NULL;
+    }
+    g_free(config);
+    win = pw->win;
+    all_wins = g_slist_prepend(all_wins, win);
+    gtk_window_set_default_size(GTK_WINDOW(win),
+                                app_config->win_width,
+                                app_config->win_height);
+    fm_tab_page_chdir(pw->page, path);
+    gtk_notebook_set_current_page(win->notebook, append_tab_page(win, pw->page));
+    g_object_unref(pw->page);
+    g_free(pw->config);
+    g_slice_free(PooledWin, pw);
+    return win;
+}
+
 FmMainWin* fm_main_win_new(FmPath* path)
 {
-    FmMainWin* win = (FmMainWin*)g_object_new(FM_MAIN_WIN_TYPE, NULL);
+    FmMainWin* win = win_pool_pop(path);
+    if(win)
+        return win;
+    win = (FmMainWin*)g_object_new(FM_MAIN_WIN_TYPE, NULL);
     /* create new tab */
     fm_main_win_add_tab(win, path);
     return win;
 }
 
+static gboolean on_win_pool_idle(gpointer user_data)
+{
+    PooledWin* pw;
+
+    if(g_slist_length(win_pool) >= win_pool_size)
+    {
+        win_pool_idle = 0;
+        return FALSE;
+    }
+    /* build one window per idle call so we don't block the main loop */
+    pw = g_slice_new(PooledWin);
+    pw->config = get_win_pool_config();
+    pw->win = (FmMainWin*)g_object_new(FM_MAIN_WIN_TYPE, NULL);
+    /* hidden windows should never be used as last active one */
+    all_wins = g_slist_remove(all_wins, pw->win);
+    gtk_window_set_default_size(GTK_WINDOW(pw->win),
+                                app_config->win_width,
+                                app_config->win_height);
+    gtk_widget_realize(GTK_WIDGET(pw->win));
+    pw->page = fm_tab_page_new(NULL);
+    g_object_ref_sink(pw->page);
+    win_pool = g_slist_prepend(win_pool, pw);
+    return TRUE;
+}
+
+/* any other setting may be used by the pooled windows, so build them again */
+static void on_win_pool_config_changed(FmConfig* cfg, gpointer user_data)
+{
+    guint size = win_pool_size;
+    fm_main_win_set_pool_size(0);
+    fm_main_win_set_pool_size(size);
+}
+
+/**
+ * fm_main_win_set_pool_size
+ * @size: number of hidden windows to keep ready
+ *
+ * Keeps up to @size windows pre-built in background so that
+ * fm_main_win_new() only needs to change directory and show it.
+ * The pool is filled when the main loop is idle. Setting @size
+ * to 0 destroys all pooled windows. Each pooled window holds a
+ * reference on the application so this should be used only in
+ * daemon mode.
+ */
+void fm_main_win_set_pool_size(guint size)
+{
+    win_pool_size = size;
+    while(g_slist_length(win_pool) > size)
+    {
+        PooledWin* pw = (PooledWin*)win_pool->data;
+        win_pool = g_slist_delete_link(win_pool, win_pool);
+        win_pool_free(pw);
+    }
+    if(size > 0 && !win_pool_config_handler)
+        win_pool_config_handler = g_signal_connect(app_config, "changed",
+                                                   G_CALLBACK(on_win_pool_config_changed), NULL);
+    else if(size == 0 && win_pool_config_handler)
+    {
+        g_signal_handler_disconnect(app_config, win_pool_config_handler);
+        win_pool_config_handler = 0;
+    }
+    if(g_slist_length(win_pool) < size)
+    {
+        if(!win_pool_idle)
+            win_pool_idle = g_idle_add_full(G_PRIORITY_LOW, on_win_pool_idle, NULL, NULL);
+    }
+    else if(win_pool_idle)
+    {
+        g_source_remove(win_pool_idle);
+        win_pool_idle = 0;
+    }
+}
+
 #if GTK_CHECK_VERSION(3, 0, 0)
 static void fm_main_win_destroy(GtkWidget *object)
 #else
@@ -639,11 +913,26 @@ static void fm_main_win_destroy(GtkObject *object)
             g_source_remove(win->idle_handler);
             win->idle_handler = 0;
         }
+        cancel_target_job(win);
 
+        /* the last window is closed, remember what was open */
+        if(all_wins && all_wins->data == win && !all_wins->next)
+            pcmanfm_save_session();
         all_wins = g_slist_remove(all_wins, win);
+        if(!all_wins && !win_pool && hibernate_handler)
+        {
+            g_source_remove(hibernate_handler);
+            hibernate_handler = 0;
+        }
 
         while(gtk_notebook_get_n_pages(win->notebook) > 0)
             gtk_notebook_remove_page(win->notebook, 0);
+        /* pages don't hold the side pane anymore */
+        g_signal_handlers_disconnect_by_func(win->side_pane, on_side_pane_mode_changed, win);
+        g_signal_handlers_disconnect_by_func(win->side_pane, on_side_pane_chdir, win);
+        gtk_widget_destroy(GTK_WIDGET(win->side_pane));
+        g_object_unref(win->side_pane);
+        win->side_pane = NULL;
     }
 
 #if GTK_CHECK_VERSION(3, 0, 0)
@@ -670,6 +959,31 @@ static void on_unrealize(GtkWidget* widget)
     (*GTK_WIDGET_CLASS(fm_main_win_parent_class)->unrealize)(widget);
 }
 
+/* the window is unrealized already when the session is saved on close,
+ * so its geometry is remembered while it's shown */
+static gboolean on_configure_event(GtkWidget* widget, GdkEventConfigure* evt)
+{
+    FmMainWin* win = FM_MAIN_WIN(widget);
+    /* keep the size to restore when it's unmaximized */
+    if(!win->maximized)
+    {
+        gtk_window_get_position(GTK_WINDOW(win), &win->x, &win->y);
+        win->width = evt->width;
+        win->height = evt->height;
+        win->has_geometry = TRUE;
+    }
+    return (*GTK_WIDGET_CLASS(fm_main_win_parent_class)->configure_event)(widget, evt);
+}
+
+static gboolean on_window_state_event(GtkWidget* widget, GdkEventWindowState* evt)
+{
+    FmMainWin* win = FM_MAIN_WIN(widget);
+    win->maximized = (evt->new_window_state & GDK_WINDOW_STATE_MAXIMIZED) != 0;
+    if(GTK_WIDGET_CLASS(fm_main_win_parent_class)->window_state_event)
+        return (*GTK_WIDGET_CLASS(fm_main_win_parent_class)->window_state_event)(widget, evt);
+    return FALSE;
+}
+
 static void on_about_response(GtkDialog* dlg, gint response, GtkDialog **dlgptr)
 {
     g_signal_handlers_disconnect_by_func(dlg, on_about_response, dlgptr);
@@ -695,12 +1009,19 @@ static void on_about(GtkAction* act, FmMainWin* win)
 static void on_open_folder_in_terminal(GtkAction* act, FmMainWin* win)
 {
     FmFileInfoList* files = fm_folder_view_dup_selected_files(win->folder_view);
+    GList* dirs = NULL;
     GList* l;
     for(l=fm_file_info_list_peek_head_link(files);l;l=l->next)
     {
         FmFileInfo* fi = (FmFileInfo*)l->data;
         if(fm_file_info_is_dir(fi) /*&& !fm_file_info_is_virtual(fi)*/)
-            pcmanfm_open_folder_in_terminal(GTK_WINDOW(win), fm_file_info_get_path(fi));
+            dirs = g_list_prepend(dirs, fm_file_info_get_path(fi));
+    }
+    if(dirs)
+    {
+        dirs = g_list_reverse(dirs);
+        pcmanfm_open_folders_in_terminal(GTK_WINDOW(win), dirs);
+        g_list_free(dirs);
     }
     fm_file_info_list_unref(files);
 }
@@ -767,6 +1088,8 @@ static void on_show_hidden(GtkToggleAction* act, FmMainWin* win)
 {
     FmTabPage* page = win->current_page;
     gboolean active = gtk_toggle_action_get_active(act);
+    /* other pages get it when they are shown */
+    win->show_hidden = active;
     fm_tab_page_set_show_hidden(page, active);
 
     if(active != app_config->show_hidden)
@@ -806,10 +1129,8 @@ static void on_sort_type(GtkRadioAction* act, GtkRadioAction *cur, FmMainWin* wi
 
 static void on_side_pane_mode(GtkRadioAction* act, GtkRadioAction *cur, FmMainWin* win)
 {
-    FmTabPage* cur_page = win->current_page;
-    FmSidePane* sp = fm_tab_page_get_side_pane(cur_page);
     int val = gtk_radio_action_get_current_value(cur);
-    fm_side_pane_set_mode(sp, val);
+    fm_side_pane_set_mode(win->side_pane, val);
 }
 
 static gboolean on_focus_in(GtkWidget* w, GdkEventFocus* evt)
@@ -924,6 +1245,107 @@ static void on_go_apps(GtkAction* act, FmMainWin* win)
     fm_main_win_chdir(win, fm_path_get_apps_menu());
 }
 
+/* max number of folders suggested in "Jump to Folder" dialog */
+#define JUMP_MAX_ITEMS 20
+
+enum
+{
+    JUMP_COL_DISP_NAME,
+    JUMP_COL_PATH_STR,
+    N_JUMP_COLS
+};
+
+static void on_jump_entry_changed(GtkEntry* entry, GtkListStore* store)
+{
+    GList* paths = pcmanfm_dir_history_match(gtk_entry_get_text(entry),
+                                             JUMP_MAX_ITEMS);
+    GList* l;
+
+    gtk_list_store_clear(store);
+    for(l = paths; l; l = l->next)
+    {
+        FmPath* path = (FmPath*)l->data;
+        char* disp_name = fm_path_display_name(path, TRUE);
+        char* path_str = fm_path_to_str(path);
+        gtk_list_store_insert_with_values(store, NULL, -1,
+                                          JUMP_COL_DISP_NAME, disp_name,
+                                          JUMP_COL_PATH_STR, path_str, -1);
+        g_free(disp_name);
+        g_free(path_str);
+    }
+    pcmanfm_dir_history_free_list(paths);
+}
+
+/* the list is already filtered by the history */
+static gboolean jump_match_all(GtkEntryCompletion* comp, const char* key,
+                               GtkTreeIter* it, gpointer user_data)
+{
+    return TRUE;
+}
+
+static gboolean on_jump_match_selected(GtkEntryCompletion* comp, GtkTreeModel* model,
+                                       GtkTreeIter* it, GtkDialog* dlg)
+{
+    char* path_str;
+    gtk_tree_model_get(model, it, JUMP_COL_PATH_STR, &path_str, -1);
+    g_object_set_data_full(G_OBJECT(dlg), "path", path_str, g_free);
+    gtk_dialog_response(dlg, GTK_RESPONSE_OK);
+    return TRUE;
+}
+
+static void on_jump_to(GtkAction* act, FmMainWin* win)
+{
+    GtkWidget* dlg = gtk_dialog_new_with_buttons(_("Jump to Folder"),
+                                    GTK_WINDOW(win), GTK_DIALOG_MODAL,
+                                    GTK_STOCK_CANCEL, GTK_RESPONSE_CANCEL,
+                                    GTK_STOCK_OK, GTK_RESPONSE_OK, NULL);
+    GtkWidget* entry = gtk_entry_new();
+    GtkListStore* store = gtk_list_store_new(N_JUMP_COLS, G_TYPE_STRING, G_TYPE_STRING);
+    GtkEntryCompletion* comp = gtk_entry_completion_new();
+    FmPath* path = NULL;
+
+    gtk_dialog_set_default_response(GTK_DIALOG(dlg), GTK_RESPONSE_OK);
+    gtk_entry_set_activates_default(GTK_ENTRY(entry), TRUE);
+    gtk_container_set_border_width(GTK_CONTAINER(dlg), 6);
+    gtk_box_pack_start(GTK_BOX(gtk_dialog_get_content_area(GTK_DIALOG(dlg))),
+                       entry, FALSE, TRUE, 6);
+    gtk_window_set_default_size(GTK_WINDOW(dlg), 400, -1);
+
+    /* the store should be refilled before the completion filters it */
+    g_signal_connect(entry, "changed", G_CALLBACK(on_jump_entry_changed), store);
+    gtk_entry_completion_set_model(comp, GTK_TREE_MODEL(store));
+    gtk_entry_completion_set_text_column(comp, JUMP_COL_DISP_NAME);
+    gtk_entry_completion_set_match_func(comp, jump_match_all, NULL, NULL);
+    g_signal_connect(comp, "match-selected", G_CALLBACK(on_jump_match_selected), dlg);
+    gtk_entry_set_completion(GTK_ENTRY(entry), comp);
+    g_object_unref(comp);
+    g_object_unref(store);
+
+    gtk_widget_show_all(dlg);
+    if(gtk_dialog_run(GTK_DIALOG(dlg)) == GTK_RESPONSE_OK)
+    {
+        const char* path_str = (const char*)g_object_get_data(G_OBJECT(dlg), "path");
+        const char* text = gtk_entry_get_text(GTK_ENTRY(entry));
+        if(path_str)
+            path = fm_path_new_for_str(path_str);
+        else if(text[0] == '/' || strstr(text, ":/"))
+            path = fm_path_new_for_display_name(text);
+        else if(text[0]) /* use the best match */
+        {
+            GList* paths = pcmanfm_dir_history_match(text, 1);
+            if(paths)
+                path = fm_path_ref((FmPath*)paths->data);
+            pcmanfm_dir_history_free_list(paths);
+        }
+    }
+    gtk_widget_destroy(dlg);
+    if(path)
+    {
+        fm_main_win_chdir(win, path);
+        fm_path_unref(path);
+    }
+}
+
 void fm_main_win_chdir_by_name(FmMainWin* win, const char* path_str)
 {
     FmPath* path = fm_path_new_for_str(path_str);
@@ -933,6 +1355,8 @@ void fm_main_win_chdir_by_name(FmMainWin* win, const char* path_str)
 
 void fm_main_win_chdir(FmMainWin* win, FmPath* path)
 {
+    /* user went elsewhere, result of pending activation is not wanted */
+    cancel_target_job(win);
     /* NOTE: fm_tab_page_chdir() calls fm_side_pane_chdir(), which can
      * trigger on_side_pane_chdir() callback. So we need to block it here. */
     g_signal_handlers_block_by_func(win->side_pane, on_side_pane_chdir, win);
@@ -983,15 +1407,15 @@ static void update_statusbar(FmMainWin* win)
         gtk_widget_hide(GTK_WIDGET(win->vol_status));
 }
 
-gint fm_main_win_add_tab(FmMainWin* win, FmPath* path)
+/* add a new tab page but don't switch to it */
+static gint append_tab_page(FmMainWin* win, FmTabPage* page)
 {
-    FmTabPage* page = fm_tab_page_new(path);
     GtkWidget* gpage = GTK_WIDGET(page);
     FmTabLabel* label = page->tab_label;
     FmFolderView* folder_view = fm_tab_page_get_folder_view(page);
     gint ret;
 
-    gtk_paned_set_position(GTK_PANED(page), app_config->splitter_pos);
+    gtk_paned_set_position(GTK_PANED(page), win->splitter_pos);
 
     gtk_widget_show(gpage);
     g_signal_connect(folder_view, "key-press-event", G_CALLBACK(on_view_key_press_event), win);
@@ -1002,8 +1426,253 @@ gint fm_main_win_add_tab(FmMainWin* win, FmPath* path)
     /* add the tab */
     ret = gtk_notebook_append_page(win->notebook, gpage, GTK_WIDGET(page->tab_label));
     gtk_notebook_set_tab_reorderable(win->notebook, gpage, TRUE);
+
+    return ret;
+}
+
+static gint add_tab_page(FmMainWin* win, FmPath* path)
+{
+    return append_tab_page(win, fm_tab_page_new(path));
+}
+
+gint fm_main_win_add_tab(FmMainWin* win, FmPath* path)
+{
+    gint ret = add_tab_page(win, path);
     gtk_notebook_set_current_page(win->notebook, ret);
+    return ret;
+}
 
+/**
+ * fm_main_win_add_tabs
+ * @win: window to add tabs to, or %NULL
+ * @paths: list of #FmPath to open
+ * Return value: the window containing new tabs
+ *
+ * Opens all @paths as tabs of @win. If @win is %NULL then a new window
+ * is created for them. Unlike calling fm_main_win_add_tab() for each
+ * path, the notebook is only switched once (to the first new tab) and
+ * the window is only presented once. A new window keeps showing the tab
+ * of the first path.
+ */
+FmMainWin* fm_main_win_add_tabs(FmMainWin* win, GList* paths)
+{
+    gint first = -1, n;
+    gboolean new_win = FALSE;
+
+    if(!paths)
+        return win;
+    if(!win)
+    {
+        win = fm_main_win_new((FmPath*)paths->data);
+        gtk_window_set_default_size(GTK_WINDOW(win),
+                                    app_config->win_width,
+                                    app_config->win_height);
+        paths = paths->next;
+        new_win = TRUE;
+    }
+    /* the tabs load their folders only when they are shown */
+    for(; paths; paths = paths->next)
+    {
+        n = append_tab_page(win, fm_tab_page_new_deferred((FmPath*)paths->data));
+        if(first < 0)
+            first = n;
+    }
+    /* new window already shows its first tab, which is the first path */
+    if(first >= 0 && !new_win)
+        gtk_notebook_set_current_page(win->notebook, first);
+    gtk_window_present(GTK_WINDOW(win));
+    return win;
+}
+
+static void save_tab_page(GKeyFile* kf, const char* group, FmTabPage* page)
+{
+    FmFolderView* fv = fm_tab_page_get_folder_view(page);
+    FmNavHistory* nh = fm_tab_page_get_history(page);
+    const GList* cur = fm_nav_history_get_cur_link(nh);
+    const GList* l;
+    GPtrArray* history = g_ptr_array_new();
+    int pos = 0, scroll;
+
+    if(page->hibernated)
+        scroll = page->hib_scroll;
+    else
+        scroll = gtk_adjustment_get_value(gtk_scrolled_window_get_vadjustment(GTK_SCROLLED_WINDOW(fv)));
+    /* save history from the oldest item */
+    for(l = g_list_last((GList*)fm_nav_history_list(nh)); l; l = l->prev)
+    {
+        const FmNavHistoryItem* item = (FmNavHistoryItem*)l->data;
+        if(l == cur)
+            pos = history->len;
+        g_ptr_array_add(history, fm_path_to_str(item->path));
+    }
+    g_key_file_set_string_list(kf, group, "history",
+                               (const char* const*)history->pdata, history->len);
+    g_key_file_set_integer(kf, group, "history_pos", pos);
+    g_key_file_set_integer(kf, group, "scroll", scroll);
+    g_key_file_set_integer(kf, group, "view_mode", fm_folder_view_get_mode(fv));
+    g_key_file_set_integer(kf, group, "sort_type", fm_folder_view_get_sort_type(fv));
+    g_key_file_set_integer(kf, group, "sort_by", fm_folder_view_get_sort_by(fv));
+    g_ptr_array_foreach(history, (GFunc)g_free, NULL);
+    g_ptr_array_free(history, TRUE);
+}
+
+/**
+ * fm_main_win_save_session
+ * @kf: key file to store the session in
+ *
+ * Saves geometry, tabs and their navigation history of all windows.
+ */
+void fm_main_win_save_session(GKeyFile* kf)
+{
+    GSList* l;
+    int i = 0;
+
+    /* the last active window is saved last, so it's restored on top */
+    for(l = g_slist_reverse(g_slist_copy(all_wins)); l; l = g_slist_delete_link(l, l))
+    {
+        FmMainWin* win = (FmMainWin*)l->data;
+        GList* pages = gtk_container_get_children(GTK_CONTAINER(win->notebook));
+        GList* pl;
+        char* group = g_strdup_printf("window%d", i);
+        int n = 0;
+
+        if(win->has_geometry)
+        {
+            g_key_file_set_integer(kf, group, "x", win->x);
+            g_key_file_set_integer(kf, group, "y", win->y);
+            g_key_file_set_integer(kf, group, "width", win->width);
+            g_key_file_set_integer(kf, group, "height", win->height);
+        }
+        g_key_file_set_boolean(kf, group, "maximized", win->maximized);
+        g_key_file_set_integer(kf, group, "current_tab",
+                               gtk_notebook_get_current_page(win->notebook));
+        for(pl = pages; pl; pl = pl->next, ++n)
+        {
+            char* tab_group = g_strdup_printf("window%d.tab%d", i, n);
+            save_tab_page(kf, tab_group, FM_TAB_PAGE(pl->data));
+            g_free(tab_group);
+        }
+        g_key_file_set_integer(kf, group, "tabs", n);
+        g_list_free(pages);
+        g_free(group);
+        ++i;
+    }
+}
+
+static FmTabPage* restore_tab_page(GKeyFile* kf, const char* group)
+{
+    gsize n_paths = 0, i;
+    char** history = g_key_file_get_string_list(kf, group, "history", &n_paths, NULL);
+    int pos = g_key_file_get_integer(kf, group, "history_pos", NULL);
+    int val;
+    FmPath** paths;
+    FmTabPage* page = NULL;
+    FmFolderView* fv;
+
+    if(!history || n_paths == 0)
+    {
+        g_strfreev(history);
+        return NULL;
+    }
+    paths = g_new(FmPath*, n_paths);
+    for(i = 0; i < n_paths; ++i)
+        paths[i] = fm_path_new_for_str(history[i]);
+    g_strfreev(history);
+    if(pos < 0 || (gsize)pos >= n_paths)
+        pos = n_paths - 1;
+    /* the folder is loaded only when the tab is shown */
+    page = fm_tab_page_new_with_history(paths, n_paths, pos,
+                                        g_key_file_get_integer(kf, group, "scroll", NULL));
+    for(i = 0; i < n_paths; ++i)
+        fm_path_unref(paths[i]);
+    g_free(paths);
+
+    fv = fm_tab_page_get_folder_view(page);
+    val = g_key_file_get_integer(kf, group, "view_mode", NULL);
+    if(FM_FOLDER_VIEW_MODE_IS_VALID(val))
+        fm_folder_view_set_mode(fv, val);
+    val = g_key_file_get_integer(kf, group, "sort_by", NULL);
+    fm_folder_view_sort(fv, g_key_file_get_integer(kf, group, "sort_type", NULL) == GTK_SORT_DESCENDING ?
+                            GTK_SORT_DESCENDING : GTK_SORT_ASCENDING,
+                        FM_FOLDER_MODEL_COL_IS_VALID(val) ? val : app_config->sort_by);
+    return page;
+}
+
+/**
+ * fm_main_win_restore_session
+ * @kf: key file saved with fm_main_win_save_session()
+ *
+ * Opens all windows of the session. Only current tab of each window
+ * loads its folder, other tabs do it when they are shown.
+ *
+ * Returns: %TRUE if any window was opened.
+ */
+gboolean fm_main_win_restore_session(GKeyFile* kf)
+{
+    int i, n, t;
+    gboolean ret = FALSE;
+
+    for(i = 0; ; ++i)
+    {
+        char* group = g_strdup_printf("window%d", i);
+        FmMainWin* win;
+        FmTabPage* cur_page;
+        GList *pages = NULL, *l;
+        int width, height, current;
+
+        if(!g_key_file_has_group(kf, group))
+        {
+            g_free(group);
+            break;
+        }
+        width = g_key_file_get_integer(kf, group, "width", NULL);
+        height = g_key_file_get_integer(kf, group, "height", NULL);
+        current = g_key_file_get_integer(kf, group, "current_tab", NULL);
+        n = g_key_file_get_integer(kf, group, "tabs", NULL);
+
+        for(t = 0; t < n; ++t)
+        {
+            char* tab_group = g_strdup_printf("window%d.tab%d", i, t);
+            FmTabPage* page = restore_tab_page(kf, tab_group);
+            g_free(tab_group);
+            if(page)
+                pages = g_list_prepend(pages, page);
+            else if(t < current) /* keep the same tab current */
+                --current;
+        }
+        if(!pages)
+        {
+            g_free(group);
+            continue;
+        }
+        pages = g_list_reverse(pages);
+        n = g_list_length(pages);
+        if(current < 0 || current >= n)
+            current = 0;
+        win = (FmMainWin*)g_object_new(FM_MAIN_WIN_TYPE, NULL);
+        /* the first added tab becomes current and is woken up at once,
+         * so add current tab first and move it to its place later */
+        cur_page = (FmTabPage*)g_list_nth_data(pages, current);
+        append_tab_page(win, cur_page);
+        for(l = pages; l; l = l->next)
+            if(l->data != cur_page)
+                append_tab_page(win, (FmTabPage*)l->data);
+        gtk_notebook_reorder_child(win->notebook, GTK_WIDGET(cur_page), current);
+        g_list_free(pages);
+        gtk_window_set_default_size(GTK_WINDOW(win),
+                                    width > 0 ? width : app_config->win_width,
+                                    height > 0 ? height : app_config->win_height);
+        /* the window manager may still place it elsewhere */
+        if(g_key_file_has_key(kf, group, "x", NULL) && g_key_file_has_key(kf, group, "y", NULL))
+            gtk_window_move(GTK_WINDOW(win),
+                            g_key_file_get_integer(kf, group, "x", NULL),
+                            g_key_file_get_integer(kf, group, "y", NULL));
+        if(g_key_file_get_boolean(kf, group, "maximized", NULL))
+            gtk_window_maximize(GTK_WINDOW(win));
+        g_free(group);
+        gtk_window_present(GTK_WINDOW(win));
+        ret = TRUE;
+    }
     return ret;
 }
 
@@ -1170,6 +1839,277 @@ static void on_prop(GtkAction* action, FmMainWin* win)
     }
 }
 
+/* Targets of shortcuts (mounts, .desktop links) are resolved in background,
+ * so a dead network target cannot block the window. Resolved targets are
+ * cached for a while so activating the same shortcut again is immediate. */
+
+/* how long a resolved target is trusted, in seconds */
+#define TARGET_CACHE_TTL 60
+/* forget everything when there are too many */
+#define TARGET_CACHE_MAX 256
+/* give up resolving after this time, in seconds */
+#define TARGET_QUERY_TIMEOUT 15
+
+typedef struct
+{
+    gboolean is_dir;
+    glong stamp;
+}TargetInfo;
+
+static GHashTable* target_cache = NULL;
+
+static glong get_now(void)
+{
+    GTimeVal now;
+    g_get_current_time(&now);
+    return now.tv_sec;
+}
+
+static TargetInfo* lookup_target(const char* target)
+{
+    TargetInfo* ti;
+    if(!target_cache)
+        return NULL;
+    ti = (TargetInfo*)g_hash_table_lookup(target_cache, target);
+    if(ti && (get_now() - ti->stamp > TARGET_CACHE_TTL || get_now() < ti->stamp))
+    {
+        g_hash_table_remove(target_cache, target);
+        ti = NULL;
+    }
+    return ti;
+}
+
+static void remember_target(const char* target, gboolean is_dir)
+{
+    TargetInfo* ti;
+    if(!target_cache)
+        target_cache = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    else if(g_hash_table_size(target_cache) >= TARGET_CACHE_MAX)
+        g_hash_table_remove_all(target_cache);
+    ti = g_new(TargetInfo, 1);
+    ti->is_dir = is_dir;
+    ti->stamp = get_now();
+    g_hash_table_replace(target_cache, g_strdup(target), ti);
+}
+
+static void launch_target(FmMainWin* win, FmPath* path, gboolean is_dir)
+{
+    if(is_dir)
+        fm_main_win_chdir(win, path);
+    else
+        fm_launch_path_simple(GTK_WINDOW(win), NULL, path, open_folder_func, win);
+}
+
+static void set_target_busy(FmMainWin* win, gboolean busy)
+{
+    GdkWindow* window = gtk_widget_get_window(GTK_WIDGET(win));
+    guint ctx = gtk_statusbar_get_context_id(win->statusbar, "target");
+
+    if(busy)
+    {
+        char* name = fm_path_display_name(win->target_path, TRUE);
+        char* msg = g_strdup_printf(_("Resolving '%s'... (press Esc to cancel)"), name);
+        gtk_statusbar_push(win->statusbar, ctx, msg);
+        g_free(msg);
+        g_free(name);
+    }
+    else
+        gtk_statusbar_pop(win->statusbar, ctx);
+    if(window)
+    {
+        GdkCursor* cursor = busy ? gdk_cursor_new(GDK_WATCH) : NULL;
+        gdk_window_set_cursor(window, cursor);
+        if(cursor)
+            gdk_cursor_unref(cursor);
+    }
+}
+
+static void on_target_job_finished(FmFileInfoJob* job, FmMainWin* win);
+
+/* stop waiting for the job and let it die in background */
+static void cancel_target_job(FmMainWin* win)
+{
+    FmFileInfoJob* job = win->target_job;
+    if(!win->target_path)
+        return;
+    if(job)
+    {
+        win->target_job = NULL;
+        g_signal_handlers_disconnect_by_func(job, on_query_target_info_error, win);
+        g_signal_handlers_disconnect_by_func(job, on_target_job_finished, win);
+        /* the job may be stuck in I/O, it will be freed when it returns */
+        fm_job_cancel(FM_JOB(job));
+        g_signal_connect(job, "finished", G_CALLBACK(g_object_unref), NULL);
+    }
+    if(win->target_timeout)
+    {
+        g_source_remove(win->target_timeout);
+        win->target_timeout = 0;
+    }
+    if(win->target_mount)
+    {
+        /* the callback owns a reference and checks it */
+        g_cancellable_cancel(win->target_mount);
+        g_object_unref(win->target_mount);
+        win->target_mount = NULL;
+    }
+    set_target_busy(win, FALSE);
+    fm_path_unref(win->target_path);
+    win->target_path = NULL;
+}
+
+static void query_target(FmMainWin* win, FmPath* path);
+
+static void on_target_mounted(GObject* src, GAsyncResult* res, gpointer user_data)
+{
+    GCancellable* cancellable = G_CANCELLABLE(user_data);
+    FmMainWin* win;
+    FmPath* path;
+    GError* err = NULL;
+
+    if(!g_file_mount_enclosing_volume_finish(G_FILE(src), res, &err)
+       && err->domain == G_IO_ERROR && err->code == G_IO_ERROR_ALREADY_MOUNTED)
+        g_clear_error(&err);
+    /* the window may be gone if it's cancelled */
+    if(g_cancellable_is_cancelled(cancellable))
+    {
+        if(err)
+            g_error_free(err);
+        g_object_unref(cancellable);
+        return;
+    }
+    win = (FmMainWin*)g_object_get_data(G_OBJECT(cancellable), "win");
+    g_object_unref(cancellable);
+    g_object_unref(win->target_mount);
+    win->target_mount = NULL;
+    set_target_busy(win, FALSE);
+    path = win->target_path;
+    win->target_path = NULL;
+    if(err)
+    {
+        if(err->domain != G_IO_ERROR || err->code != G_IO_ERROR_FAILED_HANDLED)
+            fm_show_error(GTK_WINDOW(win), NULL, err->message);
+        g_error_free(err);
+        fm_path_unref(path);
+    }
+    else /* query it again now when it's mounted */
+        query_target(win, path);
+}
+
+/* mount volume of the target without blocking the window */
+static void mount_target(FmMainWin* win, FmPath* path)
+{
+    GFile* gf = fm_path_to_gfile(path);
+    GMountOperation* op = gtk_mount_operation_new(GTK_WINDOW(win));
+
+    win->target_path = path;
+    win->target_mount = g_cancellable_new();
+    g_object_set_data(G_OBJECT(win->target_mount), "win", win);
+    set_target_busy(win, TRUE);
+    g_file_mount_enclosing_volume(gf, 0, op, win->target_mount, on_target_mounted,
+                                  g_object_ref(win->target_mount));
+    g_object_unref(op);
+    g_object_unref(gf);
+}
+
+static void on_target_job_finished(FmFileInfoJob* job, FmMainWin* win)
+{
+    FmFileInfo* target_fi = NULL;
+    FmPath* path = win->target_path;
+    gboolean need_mount = FALSE;
+
+    if(!fm_job_is_cancelled(FM_JOB(job)))
+    {
+        target_fi = fm_file_info_list_peek_head(job->file_infos);
+        need_mount = (g_object_get_data(G_OBJECT(job), "need-mount") != NULL);
+    }
+    if(target_fi)
+        fm_file_info_ref(target_fi);
+
+    g_signal_handlers_disconnect_by_func(job, on_query_target_info_error, win);
+    g_signal_handlers_disconnect_by_func(job, on_target_job_finished, win);
+    g_object_unref(job);
+    win->target_job = NULL;
+    if(win->target_timeout)
+    {
+        g_source_remove(win->target_timeout);
+        win->target_timeout = 0;
+    }
+    set_target_busy(win, FALSE);
+    win->target_path = NULL;
+
+    if(target_fi)
+    {
+        char* target = fm_path_to_str(path);
+        gboolean is_dir = fm_file_info_is_dir(target_fi);
+        remember_target(target, is_dir);
+        g_free(target);
+        fm_file_info_unref(target_fi);
+        launch_target(win, path, is_dir);
+    }
+    else if(need_mount)
+    {
+        mount_target(win, path);
+        return;
+    }
+    fm_path_unref(path);
+}
+
+static gboolean on_target_job_timeout(gpointer user_data)
+{
+    FmMainWin* win = (FmMainWin*)user_data;
+    char* name = fm_path_display_name(win->target_path, TRUE);
+    char* msg = g_strdup_printf(_("Timeout while querying info for '%s'"), name);
+
+    win->target_timeout = 0;
+    g_free(name);
+    cancel_target_job(win);
+    fm_show_error(GTK_WINDOW(win), NULL, msg);
+    g_free(msg);
+    return FALSE;
+}
+
+static void open_target(FmMainWin* win, const char* target)
+{
+    FmPath* path = fm_path_new_for_str(target);
+    char* key = fm_path_to_str(path);
+    TargetInfo* ti;
+
+    /* a new activation replaces the pending one */
+    cancel_target_job(win);
+    ti = lookup_target(key);
+    g_free(key);
+    if(ti)
+    {
+        launch_target(win, path, ti->is_dir);
+        fm_path_unref(path);
+        return;
+    }
+
+    query_target(win, path);
+}
+
+/* path is taken by the window */
+static void query_target(FmMainWin* win, FmPath* path)
+{
+    FmFileInfoJob* job = fm_file_info_job_new(NULL, 0);
+
+    fm_file_info_job_add(job, path);
+    g_signal_connect(job, "error", G_CALLBACK(on_query_target_info_error), win);
+    g_signal_connect(job, "finished", G_CALLBACK(on_target_job_finished), win);
+    if(!fm_job_run_async(FM_JOB(job)))
+    {
+        /* "finished" is not emitted for a job which is not started */
+        g_object_unref(job);
+        fm_path_unref(path);
+        return;
+    }
+    win->target_path = path;
+    win->target_job = job;
+    set_target_busy(win, TRUE);
+    win->target_timeout = g_timeout_add_seconds(TARGET_QUERY_TIMEOUT, on_target_job_timeout, win);
+}
+
 /* This callback is only connected to folder view of current active tab page. */
 static void on_folder_view_clicked(FmFolderView* fv, FmFolderViewClickType type, FmFileInfo* fi, FmMainWin* win)
 {
@@ -1184,27 +2124,7 @@ static void on_folder_view_clicked(FmFolderView* fv, FmFolderViewClickType type,
         else if(fm_file_info_get_target(fi) && !fm_file_info_is_symlink(fi))
         {
             /* symlinks also has fi->target, but we only handle shortcuts here. */
-            FmFileInfo* target_fi;
-            FmPath* real_path = fm_path_new_for_str(fm_file_info_get_target(fi));
-            /* query the info of target */
-            FmFileInfoJob* job = fm_file_info_job_new(NULL, 0);
-            fm_file_info_job_add(job, real_path);
-            g_signal_connect(job, "error", G_CALLBACK(on_query_target_info_error), win);
-            fm_job_run_sync_with_mainloop(FM_JOB(job));
-            g_signal_handlers_disconnect_by_func(job, on_query_target_info_error, win);
-            target_fi = fm_file_info_list_peek_head(job->file_infos);
-            if(target_fi)
-                fm_file_info_ref(target_fi);
-            g_object_unref(job);
-            if(target_fi)
-            {
-                if(fm_file_info_is_dir(target_fi))
-                    fm_main_win_chdir( win, real_path);
-                else
-                    fm_launch_path_simple(GTK_WINDOW(win), NULL, real_path, open_folder_func, win);
-                fm_file_info_unref(target_fi);
-            }
-            fm_path_unref(real_path);
+            open_target(win, fm_file_info_get_target(fi));
         }
         else
             fm_launch_file_simple(GTK_WINDOW(win), NULL, fi, open_folder_func, win);
@@ -1283,17 +2203,51 @@ static void on_tab_page_chdir(FmTabPage* page, FmPath* path, FmMainWin* win)
     gtk_window_set_title(GTK_WINDOW(win), fm_tab_page_get_title(page));
 }
 
+/* the side pane of the window is moved to the page which becomes current */
+static void move_side_pane(FmMainWin* win, FmTabPage* page)
+{
+    FmTabPage* old_page = win->current_page;
+
+    if(old_page == page)
+        return;
+    g_signal_handlers_block_by_func(win->side_pane, on_side_pane_chdir, win);
+    /* expanded rows of directory tree are not kept per tab, the tree
+     * is only expanded to current folder of the new page */
+    if(old_page && fm_tab_page_get_side_pane(old_page) == win->side_pane)
+        fm_tab_page_set_side_pane(old_page, NULL);
+    if(page)
+        fm_tab_page_set_side_pane(page, win->side_pane);
+    g_signal_handlers_unblock_by_func(win->side_pane, on_side_pane_chdir, win);
+}
+
+/* window-wide settings are applied to other pages only when they are
+ * shown, so changing them doesn't relayout all tabs */
+static void apply_win_settings(FmMainWin* win, FmTabPage* page)
+{
+    if(gtk_paned_get_position(GTK_PANED(page)) != win->splitter_pos)
+        gtk_paned_set_position(GTK_PANED(page), win->splitter_pos);
+    if(fm_folder_view_get_show_hidden(fm_tab_page_get_folder_view(page)) != win->show_hidden)
+        fm_tab_page_set_show_hidden(page, win->show_hidden);
+}
+
 static void on_notebook_switch_page(GtkNotebook* nb, GtkNotebookPage* new_page, guint num, FmMainWin* win)
 {
     FmTabPage* page;
+    GTimeVal now;
 
     g_return_if_fail(FM_IS_TAB_PAGE(new_page));
     page = (FmTabPage*)new_page;
+    /* do it before the page is current so its handlers ignore the changes */
+    apply_win_settings(win, page);
+    move_side_pane(win, page);
     /* connect to the new active page */
     win->current_page = page;
+    g_get_current_time(&now);
+    page->active_time = now.tv_sec;
+    /* restore the page if it was hibernated */
+    fm_tab_page_wake(page);
     win->folder_view = fm_tab_page_get_folder_view(page);
     win->nav_history = fm_tab_page_get_history(page);
-    win->side_pane = fm_tab_page_get_side_pane(page);
 
     fm_path_entry_set_path(win->location, fm_tab_page_get_cwd(page));
     gtk_window_set_title((GtkWindow*)win, fm_tab_page_get_title(page));
@@ -1322,10 +2276,6 @@ static void on_notebook_page_added(GtkNotebook* nb, GtkWidget* page, guint num,
                      G_CALLBACK(on_folder_view_sort_changed), win);
     g_signal_connect(tab_page->folder_view, "clicked",
                      G_CALLBACK(on_folder_view_clicked), win);
-    g_signal_connect(tab_page->side_pane, "mode-changed",
-                     G_CALLBACK(on_side_pane_mode_changed), win);
-    g_signal_connect(tab_page->side_pane, "chdir",
-                     G_CALLBACK(on_side_pane_chdir), win);
 
     if(gtk_notebook_get_n_pages(nb) > 1
        || app_config->always_show_tabs)
@@ -1356,17 +2306,13 @@ static void on_notebook_page_removed(GtkNotebook* nb, GtkWidget* page, guint num
         g_signal_handlers_disconnect_by_func(tab_page->folder_view,
                                              on_folder_view_clicked, win);
     }
-    g_signal_handlers_disconnect_by_func(tab_page->side_pane,
-                                         on_side_pane_mode_changed, win);
-    g_signal_handlers_disconnect_by_func(tab_page->side_pane,
-                                         on_side_pane_chdir, win);
-
     if(tab_page == win->current_page)
     {
+        /* keep the side pane for next current page */
+        move_side_pane(win, NULL);
         win->current_page = NULL;
         win->folder_view = NULL;
         win->nav_history = NULL;
-        win->side_pane = NULL;
     }
 
     if(gtk_notebook_get_n_pages(nb) > 1 || app_config->always_show_tabs)
@@ -1489,6 +2435,11 @@ static gboolean on_key_press_event(GtkWidget* w, GdkEventKey* evt)
                                    fm_tab_page_get_cwd(win->current_page));
             return TRUE;
         }
+        if(win->target_job) /* stop waiting for shortcut target */
+        {
+            cancel_target_job(win);
+            return TRUE;
+        }
     }
     return GTK_WIDGET_CLASS(fm_main_win_parent_class)->key_press_event(w, evt);
 }
@@ -65,6 +65,17 @@ struct _FmMainWin
     guint statusbar_ctx2;
     FmBookmarks* bookmarks;
     guint idle_handler; /* fix for GtkEntry bug */
+    FmFileInfoJob* target_job; /* resolving target of activated shortcut */
+    FmPath* target_path;
+    guint target_timeout;
+    GCancellable* target_mount; /* mounting volume of the target */
+    /* settings shared by all tabs, applied to a tab when it's shown */
+    int splitter_pos;
+    gboolean show_hidden;
+    /* geometry while the window was shown, for saving the session */
+    gboolean has_geometry;
+    int x, y, width, height;
+    gboolean maximized;
 };
 
 struct _FmMainWinClass
@@ -78,6 +89,11 @@ void fm_main_win_chdir(FmMainWin* win, FmPath* path);
 void fm_main_win_chdir_by_name(FmMainWin* win, const char* path_str);
 gint fm_main_win_add_tab(FmMainWin* win, FmPath* path);
 FmMainWin* fm_main_win_add_win(FmMainWin* win, FmPath* path);
+FmMainWin* fm_main_win_add_tabs(FmMainWin* win, GList* paths);
+void fm_main_win_set_pool_size(guint size);
+
+void fm_main_win_save_session(GKeyFile* kf);
+gboolean fm_main_win_restore_session(GKeyFile* kf);
 
 FmMainWin* fm_main_win_get_last_active(void);
 void fm_main_win_open_in_last_active(FmPath* path);
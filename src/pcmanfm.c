@@ -38,20 +38,28 @@
 
 #include <libfm/fm-gtk.h>
 #include "app-config.h"
+#include "dir-history.h"
 #include "main-win.h"
 #include "desktop.h"
 #include "volume-manager.h"
 #include "pref.h"
 #include "pcmanfm.h"
 #include "single-inst.h"
+#include "launcher.h"
+#include "utils.h"
 
 static int signal_pipe[2] = {-1, -1};
 gboolean daemon_mode = FALSE;
 static guint save_config_idle = 0;
+static gboolean libfm_config_dirty = FALSE;
+
+/* delay before writing config after last change */
+#define SAVE_CONFIG_DELAY_SEC 2
 
 static char** files_to_open = NULL;
 static int n_files_to_open = 0;
 static char* profile = NULL;
+static char* startup_trace = NULL;
 static gboolean no_desktop = FALSE;
 static gboolean show_desktop = FALSE;
 static gboolean desktop_off = FALSE;
@@ -63,6 +71,7 @@ static char* set_wallpaper = NULL;
 static char* wallpaper_mode = NULL;
 /* static gboolean new_win = FALSE; */
 static gboolean find_files = FALSE;
+static char* open_mode = NULL;
 static char* ipc_cwd = NULL;
 
 static int n_pcmanfm_ref = 0;
@@ -73,6 +82,7 @@ static GOptionEntry opt_entries[] =
     { "profile", 'p', 0, G_OPTION_ARG_STRING, &profile, N_("Name of configuration profile"), "<profile name>" },
     { "daemon-mode", 'd', 0, G_OPTION_ARG_NONE, &daemon_mode, N_("Run PCManFM as a daemon"), NULL },
     { "no-desktop", '\0', 0, G_OPTION_ARG_NONE, &no_desktop, N_("No function. Just to be compatible with nautilus"), NULL },
+    { "startup-trace", '\0', 0, G_OPTION_ARG_FILENAME, &startup_trace, N_("Write timeline of startup phases into file"), N_("<file>") },
 
     /* options that are acceptable for every instance of pcmanfm and will be passed through IPC. */
     { "desktop", '\0', 0, G_OPTION_ARG_NONE, &show_desktop, N_("Launch desktop manager"), NULL },
@@ -81,6 +91,7 @@ static GOptionEntry opt_entries[] =
     { "set-wallpaper", 'w', 0, G_OPTION_ARG_FILENAME, &set_wallpaper, N_("Set desktop wallpaper"), N_("<image file>") },
     { "wallpaper-mode", '\0', 0, G_OPTION_ARG_STRING, &wallpaper_mode, N_("Set mode of desktop wallpaper. <mode>=(color|stretch|fit|center|tile)"), N_("<mode>") },
     { "show-pref", '\0', 0, G_OPTION_ARG_INT, &show_pref, N_("Open preference dialog. 'n' is number of the page you want to show (1, 2, 3...)."), "n" },
+    { "open-mode", '\0', 0, G_OPTION_ARG_STRING, &open_mode, N_("Set how to open folders given in command line. <mode>=(tab|window|parent)"), N_("<mode>") },
     /* { "new-win", '\0', 'n', G_OPTION_ARG_NONE, &new_win, N_("Open new window"), NULL }, */
     /* { "find-files", 'f', 0, G_OPTION_ARG_NONE, &find_files, N_("Open Find Files utility"), NULL }, */
     {G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &files_to_open, NULL, N_("[FILE1, FILE2,...]")},
@@ -89,6 +100,43 @@ static GOptionEntry opt_entries[] =
 
 static const char* valid_wallpaper_modes[] = {"color", "stretch", "fit", "center", "tile"};
 
+enum
+{
+    OPEN_IN_LAST_ACTIVE, /* tabs of last active window */
+    OPEN_IN_NEW_WIN, /* tabs of one new window */
+    OPEN_BY_PARENT /* one new window per parent folder */
+};
+static const char* valid_open_modes[] = {"tab", "window", "parent"};
+
+/* how long we wait for info on a file given in command line */
+#define OPEN_FILE_TIMEOUT_SEC 30
+
+/* files which arrived are opened together after this delay, in ms,
+ * so a slow path does not hold the others until it times out */
+#define OPEN_BATCH_FLUSH_DELAY 200
+
+/* files given in one command line are queried in parallel, and folders
+ * retrieved meanwhile are opened together, one window update for all */
+typedef struct _OpenBatch OpenBatch;
+struct _OpenBatch
+{
+    guint mode;
+    guint n_pending; /* number of unfinished jobs */
+    FmMainWin* win; /* window for OPEN_IN_NEW_WIN */
+    GHashTable* groups; /* windows for OPEN_BY_PARENT: FmPath -> FmMainWin** */
+    GPtrArray* results; /* FmFileInfo* not opened yet, in command line order */
+    guint flush_handler;
+};
+
+typedef struct _OpenJob OpenJob;
+struct _OpenJob
+{
+    OpenBatch* batch;
+    FmFileInfoJob* job;
+    guint index; /* slot in batch->results */
+    guint timeout_handler;
+};
+
 static gboolean pcmanfm_run();
 
 /* it's not safe to call gtk+ functions in unix signal handler
@@ -165,11 +213,18 @@ static void single_inst_cb(const char* cwd, int screen_num)
     pcmanfm_run();
 }
 
+static void on_config_changed(FmConfig* cfg, gpointer user_data);
+
 int main(int argc, char** argv)
 {
     FmConfig* config;
     GError* err = NULL;
     SingleInstData inst;
+    gint64 t;
+
+    /* we don't know yet if tracing is requested so start it anyway */
+    pcmanfm_trace_start();
+    t = pcmanfm_trace_now();
 
 #ifdef ENABLE_NLS
     bindtextdomain ( GETTEXT_PACKAGE, PACKAGE_LOCALE_DIR );
@@ -184,12 +239,16 @@ int main(int argc, char** argv)
         g_error_free(err);
         return 1;
     }
+    pcmanfm_trace_phase("gtk_init_with_args", t);
+    if(!startup_trace)
+        pcmanfm_trace_stop(NULL);
 
     /* ensure that there is only one instance of pcmanfm. */
     inst.prog_name = "pcmanfm";
     inst.cb = single_inst_cb;
-    inst.opt_entries = opt_entries + 3;
+    inst.opt_entries = opt_entries + 4;
     inst.screen_num = gdk_x11_get_default_screen();
+    t = pcmanfm_trace_now();
     switch(single_inst_init(&inst))
     {
     case SINGLE_INST_CLIENT: /* we're not the first instance. */
@@ -201,6 +260,7 @@ int main(int argc, char** argv)
         return 1;
     case SINGLE_INST_SERVER: ; /* FIXME */
     }
+    pcmanfm_trace_phase("single_inst_init", t);
 
     if(pipe(signal_pipe) == 0)
     {
@@ -215,33 +275,66 @@ int main(int argc, char** argv)
         signal( SIGINT, unix_signal_handler );
     }
 
+    t = pcmanfm_trace_now();
     config = fm_app_config_new(); /* this automatically load libfm config file. */
+    pcmanfm_trace_phase("fm_app_config_new", t);
 
     /* load pcmanfm-specific config file */
+    t = pcmanfm_trace_now();
     fm_app_config_load_from_profile(FM_APP_CONFIG(config), profile);
+    pcmanfm_trace_phase("fm_app_config_load_from_profile", t);
+    fm_app_config_watch_profile(FM_APP_CONFIG(config), profile);
 
+    t = pcmanfm_trace_now();
     fm_gtk_init(config);
+    pcmanfm_trace_phase("fm_gtk_init", t);
+    g_signal_connect(config, "changed", G_CALLBACK(on_config_changed), NULL);
     /* the main part */
+    t = pcmanfm_trace_now();
     if(pcmanfm_run())
     {
+        pcmanfm_trace_phase("pcmanfm_run", t);
         fm_volume_manager_init();
+        /* keep a window ready so opening a folder is instant */
+        if(daemon_mode)
+            fm_main_win_set_pool_size(1);
+        pcmanfm_trace_mark("main loop", NULL, NULL);
         gtk_main();
         /* g_debug("main loop ended"); */
+        /* quit with windows still open, e.g. on SIGTERM */
+        if(fm_main_win_get_last_active())
+            pcmanfm_save_session();
+        fm_main_win_set_pool_size(0);
         if(desktop_running)
             fm_desktop_manager_finalize();
 
         pcmanfm_save_config(TRUE);
-        if(save_config_idle)
+        pcmanfm_dir_history_save();
+        if(pcmanfm_trace_is_running())
         {
-            g_source_remove(save_config_idle);
-            save_config_idle = 0;
+            guint n_total, n_hits, n_wasted;
+            gulong rss_kb;
+            guint n_watches;
+            char* stats;
+            fm_tab_page_get_prefetch_stats(&n_total, &n_hits, &n_wasted);
+            stats = g_strdup_printf("loaded %u, used %u, dropped %u",
+                                    n_total, n_hits, n_wasted);
+            pcmanfm_trace_mark("folder prefetch", "counts", stats);
+            g_free(stats);
+            pcmanfm_get_resource_usage(&rss_kb, &n_watches);
+            stats = g_strdup_printf("RSS %lu KiB, inotify watches %u",
+                                    rss_kb, n_watches);
+            pcmanfm_trace_mark("resource usage", "usage", stats);
+            g_free(stats);
         }
         fm_volume_manager_finalize();
     }
 
     single_inst_finalize(&inst);
     fm_gtk_finalize();
+    pcmanfm_trace_stop(startup_trace);
 
+    g_signal_handlers_disconnect_by_func(config, on_config_changed, NULL);
     g_object_unref(config);
     return 0;
 }
@@ -262,6 +355,258 @@ static FmJobErrorAction on_file_info_job_error(FmFileInfoJob* job, GError* err,
     return FM_JOB_CONTINUE;
 }
 
+static gboolean on_open_batch_unref(gpointer user_data)
+{
+    pcmanfm_unref();
+    return FALSE;
+}
+
+static void open_batch_free(OpenBatch* batch)
+{
+    if(batch->flush_handler)
+        g_source_remove(batch->flush_handler);
+    /* results were all opened by open_batch_flush() */
+    g_ptr_array_free(batch->results, TRUE);
+    if(batch->win)
+        g_object_remove_weak_pointer(G_OBJECT(batch->win), (gpointer*)&batch->win);
+    if(batch->groups)
+    {
+        GHashTableIter it;
+        FmMainWin** slot;
+        g_hash_table_iter_init(&it, batch->groups);
+        while(g_hash_table_iter_next(&it, NULL, (gpointer*)&slot))
+            if(*slot)
+                g_object_remove_weak_pointer(G_OBJECT(*slot), (gpointer*)slot);
+        g_hash_table_destroy(batch->groups);
+    }
+    g_slice_free(OpenBatch, batch);
+    /* the batch may be done before gtk_main() is started, and
+     * gtk_main_quit() can be called only from the main loop */
+    g_idle_add(on_open_batch_unref, NULL);
+}
+
+/* get pointer to the window the path should be opened in */
+static FmMainWin** open_batch_get_slot(OpenBatch* batch, FmPath* path)
+{
+    FmPath* parent;
+    FmMainWin** slot;
+
+    if(batch->mode != OPEN_BY_PARENT)
+        return &batch->win;
+    parent = fm_path_get_parent(path);
+    if(!parent) /* root folder is a group itself */
+        parent = path;
+    slot = g_hash_table_lookup(batch->groups, parent);
+    if(!slot)
+    {
+        slot = g_new0(FmMainWin*, 1);
+        g_hash_table_insert(batch->groups, fm_path_ref(parent), slot);
+    }
+    return slot;
+}
+
+static gboolean open_batch_folders(GAppLaunchContext* ctx, GList* folder_infos, gpointer user_data, GError** err)
+{
+    OpenBatch* batch = (OpenBatch*)user_data;
+    GHashTable* tabs; /* FmMainWin** -> GList* of FmPath, reversed */
+    GList* slots = NULL; /* in order of their first folder */
+    GList* l;
+
+    if(batch->mode == OPEN_IN_LAST_ACTIVE)
+        return pcmanfm_open_folder(ctx, folder_infos, NULL, err);
+    tabs = g_hash_table_new(g_direct_hash, g_direct_equal);
+    for(l = folder_infos; l; l=l->next)
+    {
+        FmPath* path = fm_file_info_get_path((FmFileInfo*)l->data);
+        FmMainWin** slot = open_batch_get_slot(batch, path);
+        GList* paths = (GList*)g_hash_table_lookup(tabs, slot);
+        if(!paths)
+            slots = g_list_prepend(slots, slot);
+        g_hash_table_insert(tabs, slot, g_list_prepend(paths, path));
+    }
+    /* each window is updated and presented once for all its folders */
+    slots = g_list_reverse(slots);
+    for(l = slots; l; l=l->next)
+    {
+        FmMainWin** slot = (FmMainWin**)l->data;
+        GList* paths = g_list_reverse((GList*)g_hash_table_lookup(tabs, slot));
+        if(*slot) /* the window was already opened by this batch */
+            fm_main_win_add_tabs(*slot, paths);
+        else
+        {
+            *slot = fm_main_win_add_tabs(NULL, paths);
+            g_object_add_weak_pointer(G_OBJECT(*slot), (gpointer*)slot);
+        }
+        g_list_free(paths);
+    }
+    g_list_free(slots);
+    g_hash_table_destroy(tabs);
+    return TRUE;
+}
+
+/* open all the files retrieved so far */
+static void open_batch_flush(OpenBatch* batch)
+{
+    GList* infos = NULL;
+    guint i;
+
+    if(batch->flush_handler)
+    {
+        g_source_remove(batch->flush_handler);
+        batch->flush_handler = 0;
+    }
+    for(i = batch->results->len; i > 0; --i)
+    {
+        FmFileInfo* fi = (FmFileInfo*)g_ptr_array_index(batch->results, i - 1);
+        if(fi)
+        {
+            infos = g_list_prepend(infos, fi);
+            g_ptr_array_index(batch->results, i - 1) = NULL;
+        }
+    }
+    if(infos)
+    {
+        fm_launch_files_simple(NULL, NULL, infos, open_batch_folders, batch);
+        g_list_foreach(infos, (GFunc)fm_file_info_unref, NULL);
+        g_list_free(infos);
+    }
+}
+
+static gboolean on_open_batch_flush(gpointer user_data)
+{
+    OpenBatch* batch = (OpenBatch*)user_data;
+    batch->flush_handler = 0;
+    open_batch_flush(batch);
+    return FALSE;
+}
+
+/* the batch is freed when its last job is done */
+static void open_batch_release(OpenBatch* batch)
+{
+    if(--batch->n_pending > 0)
+        return;
+    open_batch_flush(batch);
+    open_batch_free(batch);
+}
+
+static void open_job_free(OpenJob* oj)
+{
+    OpenBatch* batch = oj->batch;
+
+    if(oj->timeout_handler)
+        g_source_remove(oj->timeout_handler);
+    g_signal_handlers_disconnect_by_func(oj->job, on_file_info_job_error, NULL);
+    g_object_unref(oj->job);
+    g_slice_free(OpenJob, oj);
+    open_batch_release(batch);
+}
+
+static void on_open_job_finished(FmFileInfoJob* job, OpenJob* oj)
+{
+    g_signal_handlers_disconnect_by_func(job, on_open_job_finished, oj);
+    if(!fm_job_is_cancelled(FM_JOB(job)))
+    {
+        FmFileInfo* fi = fm_file_info_list_peek_head(job->file_infos);
+        OpenBatch* batch = oj->batch;
+        if(fi)
+        {
+            g_ptr_array_index(batch->results, oj->index) = fm_file_info_ref(fi);
+            /* wait a bit for other files, they're opened together */
+            if(!batch->flush_handler)
+                batch->flush_handler = g_timeout_add(OPEN_BATCH_FLUSH_DELAY,
+                                                     on_open_batch_flush, batch);
+        }
+    }
+    open_job_free(oj);
+}
+
+static gboolean on_open_job_timeout(gpointer user_data)
+{
+    OpenJob* oj = (OpenJob*)user_data;
+    FmFileInfoJob* job = oj->job;
+    FmPath* path = fm_file_info_job_get_current(job);
+    char* path_str = path ? fm_path_display_name(path, TRUE) : NULL;
+    char* msg;
+
+    oj->timeout_handler = 0;
+    /* the job may be stuck in I/O so don't wait for it, just let it die */
+    g_signal_handlers_disconnect_by_func(job, on_open_job_finished, oj);
+    fm_job_cancel(FM_JOB(job));
+    g_signal_connect(job, "finished", G_CALLBACK(g_object_unref), NULL);
+    g_object_ref(job);
+    open_job_free(oj);
+
+    msg = g_strdup_printf(_("Timeout while querying info for '%s'"), path_str ? path_str : "");
+    g_free(path_str);
+    fm_show_error(NULL, NULL, msg);
+    g_free(msg);
+    return FALSE;
+}
+
+static void open_batch_add_path(OpenBatch* batch, FmPath* path)
+{
+    OpenJob* oj = g_slice_new(OpenJob);
+    oj->batch = batch;
+    oj->index = batch->results->len;
+    g_ptr_array_add(batch->results, NULL);
+    oj->job = fm_file_info_job_new(NULL, 0);
+    fm_file_info_job_add(oj->job, path);
+    g_signal_connect(oj->job, "error", G_CALLBACK(on_file_info_job_error), NULL);
+    g_signal_connect(oj->job, "finished", G_CALLBACK(on_open_job_finished), oj);
+    oj->timeout_handler = g_timeout_add_seconds(OPEN_FILE_TIMEOUT_SEC, on_open_job_timeout, oj);
+    ++batch->n_pending;
+    if(!fm_job_run_async(FM_JOB(oj->job)))
+    {
+        g_signal_handlers_disconnect_by_func(oj->job, on_open_job_finished, oj);
+        open_job_free(oj);
+    }
+}
+
+static char* get_session_file(gboolean create)
+{
+    char* dir = pcmanfm_get_profile_dir(create);
+    char* file = g_build_filename(dir, "session", NULL);
+    g_free(dir);
+    return file;
+}
+
+void pcmanfm_save_session(void)
+{
+    GKeyFile* kf;
+    char* file;
+    char* data;
+    gsize len;
+    GError* err = NULL;
+
+    if(!app_config->restore_session)
+        return;
+    kf = g_key_file_new();
+    fm_main_win_save_session(kf);
+    data = g_key_file_to_data(kf, &len, NULL);
+    file = get_session_file(TRUE);
+    if(!g_file_set_contents(file, data, len, &err))
+    {
+        g_warning("failed to save session: %s", err->message);
+        g_error_free(err);
+    }
+    g_free(file);
+    g_free(data);
+    g_key_file_free(kf);
+}
+
+static gboolean restore_session(void)
+{
+    GKeyFile* kf = g_key_file_new();
+    char* file = get_session_file(FALSE);
+    gboolean ret = FALSE;
+
+    if(g_key_file_load_from_file(kf, file, 0, NULL))
+        ret = fm_main_win_restore_session(kf);
+    g_free(file);
+    g_key_file_free(kf);
+    return ret;
+}
+
 gboolean pcmanfm_run()
 {
     gboolean ret = TRUE;
@@ -273,7 +618,9 @@ gboolean pcmanfm_run()
         {
             if(!desktop_running)
             {
+                gint64 t = pcmanfm_trace_now();
                 fm_desktop_manager_init();
+                pcmanfm_trace_phase("fm_desktop_manager_init", t);
                 desktop_running = TRUE;
             }
             show_desktop = FALSE;
@@ -366,9 +713,35 @@ gboolean pcmanfm_run()
         if(files_to_open)
         {
             char** filename;
-            FmFileInfoJob* job = fm_file_info_job_new(NULL, 0);
             FmPath* cwd = NULL;
-            GList* infos;
+            OpenBatch* batch = g_slice_new0(OpenBatch);
+            batch->results = g_ptr_array_new();
+
+            if(open_mode)
+            {
+                guint i;
+                for(i = 0; i < G_N_ELEMENTS(valid_open_modes); ++i)
+                {
+                    if(strcmp(valid_open_modes[i], open_mode) == 0)
+                    {
+                        batch->mode = i;
+                        break;
+                    }
+                }
+                g_free(open_mode);
+                open_mode = NULL;
+            }
+            if(batch->mode == OPEN_BY_PARENT)
+                batch->groups = g_hash_table_new_full((GHashFunc)fm_path_hash,
+                                                      (GEqualFunc)fm_path_equal,
+                                                      (GDestroyNotify)fm_path_unref,
+                                                      g_free);
+            /* the batch keeps us running until all files are opened */
+            pcmanfm_ref();
+
+            /* every file is queried with its own job so a slow or
+             * unreachable path does not delay opening of others */
+            ++batch->n_pending; /* hold the batch while jobs are added */
             for(filename=files_to_open; *filename; ++filename)
             {
                 FmPath* path;
@@ -377,11 +750,7 @@ gboolean pcmanfm_run()
                 else if(strstr(*filename, ":/") ) /* URI */
                     path = fm_path_new_for_uri(*filename);
                 else if( strcmp(*filename, "~") == 0 ) /* special case for home dir */
-                {
-                    path = fm_path_get_home();
-                    fm_main_win_add_win(NULL, path);
-                    continue;
-                }
+                    path = fm_path_ref(fm_path_get_home());
                 else /* basename */
                 {
                     if(G_UNLIKELY(!cwd))
@@ -394,17 +763,13 @@ gboolean pcmanfm_run()
                     }
                     path = fm_path_new_relative(cwd, *filename);
                 }
-                fm_file_info_job_add(job, path);
+                open_batch_add_path(batch, path);
                 fm_path_unref(path);
             }
             if(cwd)
                 fm_path_unref(cwd);
-            g_signal_connect(job, "error", G_CALLBACK(on_file_info_job_error), NULL);
-            fm_job_run_sync_with_mainloop(FM_JOB(job));
-            infos = fm_file_info_list_peek_head_link(job->file_infos);
-            fm_launch_files_simple(NULL, NULL, infos, pcmanfm_open_folder, NULL);
-            g_object_unref(job);
-            ret = (n_pcmanfm_ref >= 1); /* if there is opened window, return true to run the main loop. */
+            open_batch_release(batch);
+            ret = (n_pcmanfm_ref >= 1); /* if there is opened window or pending job, return true to run the main loop. */
 
             g_strfreev(files_to_open);
             files_to_open = NULL;
@@ -419,6 +784,12 @@ gboolean pcmanfm_run()
                * Checking if pcmanfm_run() is called the first time is needed to fix
                * #3397444 - pcmanfm dont show window in daemon mode if i call 'pcmanfm' */
             }
+            else if(first_run && app_config->restore_session && restore_session())
+            {
+                /* windows of last session are opened again */
+                g_free(ipc_cwd);
+                ipc_cwd = NULL;
+            }
             else
             {
                 /* If we're not in daemon mode, or pcmanfm_run() is called because another
@@ -486,19 +857,37 @@ static void move_window_to_desktop(FmMainWin* win, FmDesktop* desktop)
 gboolean pcmanfm_open_folder(GAppLaunchContext* ctx, GList* folder_infos, gpointer user_data, GError** err)
 {
     GList* l = folder_infos;
+    GList* paths = NULL;
+    FmMainWin* win;
+
     for(; l; l=l->next)
     {
         FmFileInfo* fi = (FmFileInfo*)l->data;
-        fm_main_win_open_in_last_active(fm_file_info_get_path(fi));
+        paths = g_list_prepend(paths, fm_file_info_get_path(fi));
     }
-    if(user_data && FM_IS_DESKTOP(user_data))
-        move_window_to_desktop(fm_main_win_get_last_active(), user_data);
+    paths = g_list_reverse(paths);
+    win = fm_main_win_add_tabs(fm_main_win_get_last_active(), paths);
+    g_list_free(paths);
+    if(win && user_data && FM_IS_DESKTOP(user_data))
+        move_window_to_desktop(win, user_data);
     return TRUE;
 }
 
+static void on_config_changed(FmConfig* cfg, gpointer user_data)
+{
+    /* libfm config keys are only changed along with "changed" signal */
+    libfm_config_dirty = TRUE;
+}
+
 static gboolean on_save_config_idle(gpointer user_data)
 {
-    pcmanfm_save_config(TRUE);
+    if(libfm_config_dirty)
+    {
+        fm_config_save(fm_config, NULL);
+        libfm_config_dirty = FALSE;
+    }
+    if(!fm_app_config_save_profile_async(app_config, profile))
+        return TRUE; /* previous write is still in progress, try again later */
     save_config_idle = 0;
     return FALSE;
 }
@@ -507,38 +896,47 @@ void pcmanfm_save_config(gboolean immediate)
 {
     if(immediate)
     {
-        fm_config_save(fm_config, NULL);
+        if(save_config_idle)
+        {
+            g_source_remove(save_config_idle);
+            save_config_idle = 0;
+        }
+        if(libfm_config_dirty)
+        {
+            fm_config_save(fm_config, NULL);
+            libfm_config_dirty = FALSE;
+        }
         fm_app_config_save_profile(app_config, profile);
     }
     else
     {
-        /* install an idle handler to save the config file. */
-        if( 0 == save_config_idle)
-            save_config_idle = g_idle_add_full(G_PRIORITY_LOW, (GSourceFunc)on_save_config_idle, NULL, NULL);
+        /* coalesce frequent changes (e.g. dragging splitter) into one write,
+         * it's done only when there were no changes for a while. */
+        if(save_config_idle)
+            g_source_remove(save_config_idle);
+        save_config_idle = g_timeout_add_seconds(SAVE_CONFIG_DELAY_SEC, on_save_config_idle, NULL);
     }
 }
 
-void pcmanfm_open_folder_in_terminal(GtkWindow* parent, FmPath* dir)
+void pcmanfm_open_folders_in_terminal(GtkWindow* parent, GList* dirs)
 {
-    GAppInfo* app;
+    GPtrArray* cwds;
+    GList* l;
+    GError* err = NULL;
     char** argv;
     int argc;
+
     if(!fm_config->terminal)
     {
         fm_show_error(parent, NULL, _("Terminal emulator is not set."));
         fm_edit_preference(parent, PREF_ADVANCED);
         return;
     }
-    if(!g_shell_parse_argv(fm_config->terminal, &argc, &argv, NULL))
-        return;
-    app = g_app_info_create_from_commandline(argv[0], NULL, 0, NULL);
-    g_strfreev(argv);
-    if(app)
+    cwds = g_ptr_array_new();
+    for(l = dirs; l; l = l->next)
     {
-        GError* err = NULL;
-        GdkAppLaunchContext* ctx = gdk_app_launch_context_new();
+        FmPath* dir = (FmPath*)l->data;
         char* cwd_str;
-        char* old_cwd = g_get_current_dir();
 
         if(fm_path_is_native(dir))
             cwd_str = fm_path_to_str(dir);
@@ -548,23 +946,46 @@ void pcmanfm_open_folder_in_terminal(GtkWindow* parent, FmPath* dir)
             cwd_str = g_file_get_path(gf);
             g_object_unref(gf);
         }
+        /* folder has no local path, let the terminal start in home */
+        if(!cwd_str)
+            cwd_str = g_strdup(g_get_home_dir());
+        g_ptr_array_add(cwds, cwd_str);
+    }
+    g_ptr_array_add(cwds, NULL);
+
+    /* the setting is like "xterm -e %s" for running programs, only the
+     * terminal itself is used to open a folder */
+    if(g_shell_parse_argv(fm_config->terminal, &argc, &argv, NULL))
+    {
+        GdkAppLaunchContext* ctx = gdk_app_launch_context_new();
+        int i;
+        for(i = 1; i < argc; ++i)
+        {
+            g_free(argv[i]);
+            argv[i] = NULL;
+        }
         gdk_app_launch_context_set_screen(ctx, parent ? gtk_widget_get_screen(GTK_WIDGET(parent)) : gdk_screen_get_default());
         gdk_app_launch_context_set_timestamp(ctx, gtk_get_current_event_time());
-        g_chdir(cwd_str); /* FIXME: currently we don't have better way for this. maybe a wrapper script? */
-        g_free(cwd_str);
-
-        if(!g_app_info_launch(app, NULL, G_APP_LAUNCH_CONTEXT(ctx), &err))
+        /* the terminal gets its working dir in child process, so our own
+         * cwd is never changed and doesn't hold any mount busy (#3114626) */
+        pcmanfm_launch_in_dirs(G_APP_LAUNCH_CONTEXT(ctx), argv,
+                               (const char* const*)cwds->pdata, &err);
+        if(err)
         {
             fm_show_error(parent, NULL, err->message);
             g_error_free(err);
         }
         g_object_unref(ctx);
-        g_object_unref(app);
-
-        /* switch back to old cwd and fix #3114626 - PCManFM 0.9.9 Umount partitions problem */
-        g_chdir(old_cwd); /* This is really dirty, but we don't have better solution now. */
-        g_free(old_cwd);
+        g_strfreev(argv);
     }
+    g_strfreev((char**)g_ptr_array_free(cwds, FALSE));
+}
+
+void pcmanfm_open_folder_in_terminal(GtkWindow* parent, FmPath* dir)
+{
+    GList* dirs = g_list_prepend(NULL, dir);
+    pcmanfm_open_folders_in_terminal(parent, dirs);
+    g_list_free(dirs);
 }
 
 /* FIXME: Need to load content of ~/Templates and list available templates in popup menus. */
@@ -40,7 +40,12 @@ gboolean pcmanfm_open_folder(GAppLaunchContext* ctx, GList* folder_infos, gpoint
 char* pcmanfm_get_profile_dir(gboolean create);
 void pcmanfm_save_config(gboolean immediate);
 
+/* remember open windows, if restoring of session is enabled */
+void pcmanfm_save_session(void);
+
 void pcmanfm_open_folder_in_terminal(GtkWindow* parent, FmPath* dir);
+/* open terminal once in each folder of the list of FmPath */
+void pcmanfm_open_folders_in_terminal(GtkWindow* parent, GList* dirs);
 
 #define TEMPL_NAME_FOLDER    NULL
 #define TEMPL_NAME_BLANK     (const char*)-1
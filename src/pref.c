@@ -306,6 +306,7 @@ void fm_edit_preference( GtkWindow* parent, int page )
         INIT_BOOL(builder, FmAppConfig, always_show_tabs, NULL);
         INIT_BOOL(builder, FmAppConfig, hide_close_btn, NULL);
         INIT_BOOL(builder, FmConfig, si_unit, NULL);
+        INIT_BOOL(builder, FmAppConfig, restore_session, NULL);
 
         INIT_COMBO(builder, FmAppConfig, bm_open_method, NULL);
         INIT_COMBO(builder, FmAppConfig, view_mode, NULL);
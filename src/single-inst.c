@@ -19,17 +19,38 @@
  *      MA 02110-1301, USA.
  */
 
+/* for struct ucred */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include "single-inst.h"
 
 #include <string.h>
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <sys/socket.h>
 #include <sys/un.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <errno.h>
 #include <stdio.h>
 
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+/* Linux supports abstract socket namespace which does not leave any
+ * stale socket files in the file system if the server process dies */
+#ifdef __linux__
+#define USE_ABSTRACT_SOCKET 1
+#endif
+
+/* how long client waits for a busy server to accept connection */
+#define CLIENT_TIMEOUT_SEC 5
+
 typedef struct _SingleInstClient SingleInstClient;
 struct _SingleInstClient
 {
@@ -44,7 +65,7 @@ struct _SingleInstClient
 
 static GList* clients = NULL;
 
-static void get_socket_name(SingleInstData* data, char* buf, int len);
+static int get_socket_name(SingleInstData* data, struct sockaddr_un* addr);
 static gboolean on_server_socket_event(GIOChannel* ioc, GIOCondition cond, gpointer data);
 static gboolean on_client_socket_event(GIOChannel* ioc, GIOCondition cond, gpointer user_data);
 
@@ -60,48 +81,72 @@ static void single_inst_client_free(SingleInstClient* client)
     /* g_debug("free client"); */
 }
 
-/* FIXME: need to document IPC protocol format */
-static void pass_args_to_existing_instance(const GOptionEntry* opt_entries, int screen_num, int sock)
+/* IPC protocol:
+ * The socket is of SOCK_SEQPACKET type so message boundaries are kept.
+ * Client sends one message per argument, each message contains the
+ * argument string including terminating '\0', so there is no need to
+ * escape anything and zero-length message is never sent. The first
+ * message is current working directory of the client, the second one
+ * is screen number, all other messages are command line arguments.
+ * Client closes the connection after the last argument is sent, then
+ * server parses collected arguments. */
+static gboolean send_arg(int sock, const char* str)
+{
+    size_t len = strlen(str) + 1;
+    return send(sock, str, len, MSG_NOSIGNAL) == (ssize_t)len;
+}
+
+static gboolean send_opt(int sock, const GOptionEntry* ent)
+{
+    char buf[64];
+    g_snprintf(buf, sizeof(buf), "--%s", ent->long_name);
+    return send_arg(sock, buf);
+}
+
+static gboolean send_str_arg(int sock, const char* str)
+{
+    if(g_str_has_prefix(str, "--")) /* strings begining with -- */
+    {
+        if(!send_arg(sock, "--")) /* prepend a -- to it */
+            return FALSE;
+    }
+    return send_arg(sock, str);
+}
+
+static gboolean pass_args_to_existing_instance(const GOptionEntry* opt_entries, int screen_num, int sock)
 {
     const GOptionEntry* ent;
-    FILE* f = fdopen(sock, "w");
-    char* escaped;
+    char buf[64];
+    gboolean ok;
 
     /* pass cwd */
     char* cwd = g_get_current_dir();
-    escaped = g_strescape(cwd, NULL);
-    fprintf(f, "%s\n", escaped);
-    g_free(escaped);
+    ok = send_arg(sock, cwd);
     g_free(cwd);
 
     /* pass screen number */
-    fprintf(f, "%d\n", screen_num);
+    g_snprintf(buf, sizeof(buf), "%d", screen_num);
+    ok = ok && send_arg(sock, buf);
 
-    for(ent = opt_entries; ent->long_name; ++ent)
+    for(ent = opt_entries; ok && ent->long_name; ++ent)
     {
         switch(ent->arg)
         {
         case G_OPTION_ARG_NONE:
             if(*(gboolean*)ent->arg_data)
-                fprintf(f, "--%s\n", ent->long_name);
+                ok = send_opt(sock, ent);
             break;
         case G_OPTION_ARG_STRING:
         case G_OPTION_ARG_FILENAME:
         {
             char* str = *(char**)ent->arg_data;
             if(str && *str)
-            {
-                fprintf(f, "--%s\n", ent->long_name);
-                if(g_str_has_prefix(str, "--")) /* strings begining with -- */
-                    fprintf(f, "--\n"); /* prepend a -- to it */
-                escaped = g_strescape(str, NULL);
-                fprintf(f, "%s\n", escaped);
-                g_free(escaped);
-            }
+                ok = send_opt(sock, ent) && send_str_arg(sock, str);
             break;
         }
         case G_OPTION_ARG_INT:
-            fprintf(f, "--%s\n%d\n", ent->long_name, *(gint*)ent->arg_data);
+            g_snprintf(buf, sizeof(buf), "%d", *(gint*)ent->arg_data);
+            ok = send_opt(sock, ent) && send_arg(sock, buf);
             break;
         case G_OPTION_ARG_STRING_ARRAY:
         case G_OPTION_ARG_FILENAME_ARRAY:
@@ -110,31 +155,50 @@ static void pass_args_to_existing_instance(const GOptionEntry* opt_entries, int
             if(strv && *strv)
             {
                 if(*ent->long_name) /* G_OPTION_REMAINING = "" */
-                    fprintf(f, "--%s\n", ent->long_name);
-                for(; *strv; ++strv)
-                {
-                    char* str = *strv;
-                    if(g_str_has_prefix(str, "--")) /* strings begining with -- */
-                        fprintf(f, "--\n"); /* prepend a -- to it */
-                    escaped = g_strescape(str, NULL);
-                    fprintf(f, "%s\n", escaped);
-                    g_free(escaped);
-                }
+                    ok = send_opt(sock, ent);
+                for(; ok && *strv; ++strv)
+                    ok = send_str_arg(sock, *strv);
             }
             break;
         }
         case G_OPTION_ARG_DOUBLE:
-            fprintf(f, "--%s\n%lf\n", ent->long_name, *(gdouble*)ent->arg_data);
+            g_ascii_dtostr(buf, sizeof(buf), *(gdouble*)ent->arg_data);
+            ok = send_opt(sock, ent) && send_arg(sock, buf);
             break;
         case G_OPTION_ARG_INT64:
-            fprintf(f, "--%s\n%lld\n", ent->long_name, *(gint64*)ent->arg_data);
+            g_snprintf(buf, sizeof(buf), "%" G_GINT64_FORMAT, *(gint64*)ent->arg_data);
+            ok = send_opt(sock, ent) && send_arg(sock, buf);
             break;
         case G_OPTION_ARG_CALLBACK:
             /* Not supported */
             break;
         }
     }
-    fclose(f);
+    if(!ok)
+        g_warning("cannot pass arguments to the existing instance: %s", g_strerror(errno));
+    return ok;
+}
+
+/* abstract socket has no file permissions so anybody can connect to it
+ * or take its name first, check that the other side is our own user */
+static gboolean is_peer_trusted(int sock)
+{
+#ifdef SO_PEERCRED
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+    if(getsockopt(sock, SOL_SOCKET, SO_PEERCRED, &cred, &len) == -1)
+        return FALSE;
+    return cred.uid == getuid();
+#else
+    /* socket file is only accessible by its owner */
+    return TRUE;
+#endif
+}
+
+static inline gboolean set_nonblock(int sock)
+{
+    int flags = fcntl(sock, F_GETFL, 0);
+    return flags != -1 && fcntl(sock, F_SETFL, flags | O_NONBLOCK) != -1;
 }
 
 /**
@@ -150,38 +214,76 @@ static void pass_args_to_existing_instance(const GOptionEntry* opt_entries, int
 SingleInstResult single_inst_init(SingleInstData* data)
 {
     struct sockaddr_un addr;
+    struct timeval tv;
     int addr_len;
-    int ret;
-    int reuse;
+    int tries;
 
     data->io_channel = NULL;
     data->io_watch = 0;
-    if((data->sock = socket(AF_UNIX, SOCK_STREAM, 0)) == -1)
-        return SINGLE_INST_ERROR;
+    addr_len = get_socket_name(data, &addr);
 
-    /* FIXME: use abstract socket? */
-    addr.sun_family = AF_UNIX;
-    get_socket_name(data, addr.sun_path, sizeof(addr.sun_path));
-#ifdef SUN_LEN
-    addr_len = SUN_LEN(&addr);
-#else
-    addr_len = strlen(addr.sun_path) + sizeof(addr.sun_family);
+    /* if two instances are started simultaneously then both may fail to
+     * connect but only one will be able to bind, so try once again */
+    for(tries = 0; tries < 2; tries++)
+    {
+        if((data->sock = socket(AF_UNIX, SOCK_SEQPACKET, 0)) == -1)
+            return SINGLE_INST_ERROR;
+
+        /* don't hang forever if the server is busy or frozen */
+        tv.tv_sec = CLIENT_TIMEOUT_SEC;
+        tv.tv_usec = 0;
+        setsockopt(data->sock, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+        /* try to connect to existing instance */
+        if(connect(data->sock, (struct sockaddr*)&addr, addr_len) == 0)
+        {
+            if(!is_peer_trusted(data->sock))
+            {
+                g_warning("single instance socket is owned by another user");
+                break;
+            }
+            /* connected successfully, pass args in opt_entries to server process as argv and exit. */
+            if(pass_args_to_existing_instance(data->opt_entries, data->screen_num, data->sock))
+                return SINGLE_INST_CLIENT;
+            break;
+        }
+        if(errno == EAGAIN || errno == ETIMEDOUT)
+        {
+            /* server exists but does not accept connections */
+            g_warning("existing instance does not respond");
+            break;
+        }
+
+#ifndef USE_ABSTRACT_SOCKET
+        /* There is no existing server, and we are in the first instance. */
+        if(errno == ECONNREFUSED)
+            unlink(addr.sun_path); /* delete stale socket file if it exists. */
 #endif
 
-    /* try to connect to existing instance */
-    if(connect(data->sock, (struct sockaddr*)&addr, addr_len) == 0)
+        if(bind(data->sock, (struct sockaddr*)&addr, addr_len) == 0)
+        {
+#ifndef USE_ABSTRACT_SOCKET
+            chmod(addr.sun_path, 0600);
+#endif
+            goto _listen;
+        }
+        if(errno != EADDRINUSE)
+            break;
+        /* another instance got the address just now, connect to it */
+        close(data->sock);
+        data->sock = -1;
+    }
+    /* don't leave the socket open on errors */
+    if(data->sock != -1)
     {
-        /* connected successfully, pass args in opt_entries to server process as argv and exit. */
-        pass_args_to_existing_instance(data->opt_entries, data->screen_num, data->sock);
-        return SINGLE_INST_CLIENT;
+        close(data->sock);
+        data->sock = -1;
     }
+    return SINGLE_INST_ERROR;
 
-    /* There is no existing server, and we are in the first instance. */
-    unlink(addr.sun_path); /* delete old socket file if it exists. */
-
-    reuse = 1;
-    ret = setsockopt( data->sock, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse) );
-    if(ret || bind(data->sock, (struct sockaddr*)&addr, addr_len) == -1)
+_listen:
+    /* accept() is called in a loop until there are no more clients */
+    if(!set_nonblock(data->sock))
         return SINGLE_INST_ERROR;
 
     data->io_channel = g_io_channel_unix_new(data->sock);
@@ -191,7 +293,8 @@ SingleInstResult single_inst_init(SingleInstData* data)
     g_io_channel_set_encoding(data->io_channel, NULL, NULL);
     g_io_channel_set_buffered(data->io_channel, FALSE);
 
-    if(listen(data->sock, 5) == -1)
+    /* scripts can start lots of clients at once so use large backlog */
+    if(listen(data->sock, SOMAXCONN) == -1)
         return SINGLE_INST_ERROR;
 
     data->io_watch = g_io_add_watch(data->io_channel,
@@ -216,7 +319,9 @@ void single_inst_finalize(SingleInstData* data)
 
         if(data->io_channel)
         {
-            char sock_path[256];
+#ifndef USE_ABSTRACT_SOCKET
+            struct sockaddr_un addr;
+#endif
 
             /* disconnect all clients */
             if(clients)
@@ -233,9 +338,11 @@ void single_inst_finalize(SingleInstData* data)
             }
             g_io_channel_unref(data->io_channel);
             data->io_channel = NULL;
+#ifndef USE_ABSTRACT_SOCKET
             /* remove the file */
-            get_socket_name(data, sock_path, 256);
-            unlink(sock_path);
+            get_socket_name(data, &addr);
+            unlink(addr.sun_path);
+#endif
         }
     }
 }
@@ -258,39 +365,47 @@ static inline void parse_args(SingleInstClient* client)
 static gboolean on_client_socket_event(GIOChannel* ioc, GIOCondition cond, gpointer user_data)
 {
     SingleInstClient* client = (SingleInstClient*)user_data;
+    int fd = g_io_channel_unix_get_fd(ioc);
+    gboolean eof = FALSE;
 
     if ( cond & (G_IO_IN|G_IO_PRI) )
     {
-        char *line;
-        gsize term;
+        char* msg;
+        ssize_t len;
 
-        while(g_io_channel_read_line(ioc, &line, NULL, &term, NULL) == G_IO_STATUS_NORMAL)
+        /* peek into next message to get its size, then read it */
+        while((len = recv(fd, NULL, 0, MSG_PEEK|MSG_TRUNC|MSG_DONTWAIT)) > 0)
         {
-            if(line)
+            msg = g_malloc(len);
+            if(recv(fd, msg, len, MSG_DONTWAIT) != len || msg[len - 1] != '\0')
+            {
+                /* broken message, drop the client */
+                g_free(msg);
+                cond |= G_IO_ERR;
+                break;
+            }
+            g_debug("arg = %s", msg);
+            if(!client->cwd)
+                client->cwd = msg;
+            else if(client->screen_num == -1)
             {
-                line[term] = '\0';
-                g_debug("line = %s", line);
-                if(!client->cwd)
-                    client->cwd = g_strcompress(line);
-                else if(client->screen_num == -1)
-                {
-                    client->screen_num = atoi(line);
-                    if(client->screen_num < 0)
-                        client->screen_num = 0;
-                }
-                else
-                {
-                    char* str = g_strcompress(line);
-                    g_ptr_array_add(client->argv, str);
-                }
-                g_free(line);
+                client->screen_num = atoi(msg);
+                if(client->screen_num < 0)
+                    client->screen_num = 0;
+                g_free(msg);
             }
+            else
+                g_ptr_array_add(client->argv, msg);
         }
+        if(len == 0) /* client closed the connection */
+            eof = TRUE;
+        else if(len < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+            cond |= G_IO_ERR;
     }
 
-    if(cond & (G_IO_ERR|G_IO_HUP))
+    if(eof || (cond & (G_IO_ERR|G_IO_HUP)))
     {
-        if(! (cond & G_IO_ERR) ) /* if there is no error */
+        if(! (cond & G_IO_ERR) && client->cwd) /* if there is no error */
         {
             /* try to parse argv */
             parse_args(client);
@@ -309,12 +424,22 @@ static gboolean on_server_socket_event(GIOChannel* ioc, GIOCondition cond, gpoin
 
     if ( cond & (G_IO_IN|G_IO_PRI) )
     {
-        int client_sock = accept(g_io_channel_unix_get_fd(ioc), NULL, 0);
-        if(client_sock != -1)
+        int client_sock;
+        /* accept all pending clients at once */
+        while((client_sock = accept(g_io_channel_unix_get_fd(ioc), NULL, 0)) != -1)
         {
-            SingleInstClient* client = g_slice_new0(SingleInstClient);
+            SingleInstClient* client;
+            if(!is_peer_trusted(client_sock))
+            {
+                g_warning("connection to single instance socket from another user refused");
+                close(client_sock);
+                continue;
+            }
+            client = g_slice_new0(SingleInstClient);
+            set_nonblock(client_sock);
             client->channel = g_io_channel_unix_new(client_sock);
             g_io_channel_set_encoding(client->channel, NULL, NULL);
+            g_io_channel_set_buffered(client->channel, FALSE);
             client->screen_num = -1;
             client->argv = g_ptr_array_new();
             client->callback = data->cb;
@@ -325,7 +450,7 @@ static gboolean on_server_socket_event(GIOChannel* ioc, GIOCondition cond, gpoin
             clients = g_list_prepend(clients, client);
             /* g_debug("accept new client"); */
         }
-        else
+        if(errno != EAGAIN && errno != EWOULDBLOCK)
             g_debug("accept() failed!\n%s", g_strerror(errno));
     }
 
@@ -339,10 +464,12 @@ static gboolean on_server_socket_event(GIOChannel* ioc, GIOCondition cond, gpoin
     return TRUE;
 }
 
-static void get_socket_name(SingleInstData* data, char* buf, int len)
+/* fills the address and returns its length */
+static int get_socket_name(SingleInstData* data, struct sockaddr_un* addr)
 {
     const char* dpy = g_getenv("DISPLAY");
     char* host = NULL;
+    char* name;
     int dpynum;
     if(dpy)
     {
@@ -352,11 +479,33 @@ static void get_socket_name(SingleInstData* data, char* buf, int len)
     }
     else
         dpynum = 0;
-    g_snprintf(buf, len, "%s/.%s-socket-%s-%d-%s",
-                g_get_tmp_dir(),
-                data->prog_name,
-                host ? host : "",
-                dpynum,
-                g_get_user_name());
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+#ifdef USE_ABSTRACT_SOCKET
+    /* abstract socket name starts with '\0' and is not '\0'-terminated */
+    name = g_strdup_printf("%s-socket-%s-%d-%s",
+                           data->prog_name,
+                           host ? host : "",
+                           dpynum,
+                           g_get_user_name());
+    strncpy(addr->sun_path + 1, name, sizeof(addr->sun_path) - 1);
+    g_free(host);
+    g_free(name);
+    return offsetof(struct sockaddr_un, sun_path) + 1 + strnlen(addr->sun_path + 1, sizeof(addr->sun_path) - 1);
+#else
+    name = g_strdup_printf("%s/.%s-socket-%s-%d-%s",
+                           g_get_tmp_dir(),
+                           data->prog_name,
+                           host ? host : "",
+                           dpynum,
+                           g_get_user_name());
+    strncpy(addr->sun_path, name, sizeof(addr->sun_path) - 1);
+    g_free(host);
+    g_free(name);
+#ifdef SUN_LEN
+    return SUN_LEN(addr);
+#else
+    return strlen(addr->sun_path) + sizeof(addr->sun_family);
+#endif
+#endif
 }
-
@@ -23,6 +23,27 @@
 #include "app-config.h"
 #include "main-win.h"
 #include "tab-page.h"
+#include "utils.h"
+#include "folder-snapshot.h"
+#include "fs-info-cache.h"
+#include "dir-history.h"
+
+/* delay before showing a folder which is still loading, in milliseconds */
+#define PARTIAL_LOADING_DELAY 100
+/* number of files added to the view at once while the folder is loading */
+#define PARTIAL_LOADING_BATCH 256
+/* info of files which FmFileInfo needs */
+#define PARTIAL_LOADING_ATTRIBUTES "standard::*,unix::*,time::*,access::*,id::filesystem"
+
+/* minimal interval between status text updates, in milliseconds */
+#define STATUS_UPDATE_INTERVAL 200
+
+/* if more files than CHURN_THRESHOLD are changed in the folder during
+ * CHURN_INTERVAL, changes are collected and applied to the model once
+ * per interval until the folder calms down for CHURN_QUIET_TICKS intervals */
+#define CHURN_INTERVAL 250
+#define CHURN_THRESHOLD 50
+#define CHURN_QUIET_TICKS 4
 
 #define GET_MAIN_WIN(page)   FM_MAIN_WIN(gtk_widget_get_toplevel(GTK_WIDGET(page)))
 
@@ -38,14 +59,21 @@ static guint signals[N_SIGNALS];
 static void fm_tab_page_finalize(GObject *object);
 static void fm_tab_page_chdir_without_history(FmTabPage* page, FmPath* path);
 static void on_folder_fs_info(FmFolder* folder, FmTabPage* page);
+static void update_fs_info_text(gpointer user_data);
 static void on_folder_start_loading(FmFolder* folder, FmTabPage* page);
 static void on_folder_finish_loading(FmFolder* folder, FmTabPage* page);
 static void on_folder_removed(FmFolder* folder, FmTabPage* page);
 static void on_folder_unmount(FmFolder* folder, FmTabPage* page);
 static void on_folder_content_changed(FmFolder* folder, FmTabPage* page);
+static void on_folder_files_added(FmFolder* folder, GSList* files, FmTabPage* page);
+static void on_folder_files_removed(FmFolder* folder, GSList* files, FmTabPage* page);
+static void on_folder_files_changed(FmFolder* folder, GSList* files, FmTabPage* page);
+static void stop_churn(FmTabPage* page, gboolean apply);
+static void cancel_partial_list(FmTabPage* page);
 static FmJobErrorAction on_folder_error(FmFolder* folder, GError* err, FmJobErrorSeverity severity, FmTabPage* page);
 
 static void on_folder_view_sel_changed(FmFolderView* fv, gint n_sel, FmTabPage* page);
+static void cancel_sel_count(FmTabPage* page);
 static char* format_status_text(FmTabPage* page);
 
 #if GTK_CHECK_VERSION(3, 0, 0)
@@ -119,15 +147,207 @@ static void fm_tab_page_finalize(GObject *object)
     G_OBJECT_CLASS(fm_tab_page_parent_class)->finalize(object);
 }
 
+/* Models of folders which were recently left, most recent first.
+ * Each model is live (still tracks changes of its folder) and sorted,
+ * so going back to the folder doesn't need to populate and sort again.
+ * A model is taken out of the cache while a view shows it. */
+typedef struct
+{
+    FmFolderModel* model;
+    FmFolder* folder;
+    gulong reload_handler;
+    gboolean show_hidden;
+    int sort_by;
+    GtkSortType sort_type;
+    guint n_items;
+}CachedModel;
+
+/* maximum total number of files in cached models */
+#define MODEL_CACHE_MAX_ITEMS 200000
+/* maximum number of cached models, each keeps its folder monitored */
+#define MODEL_CACHE_MAX_MODELS 12
+
+static GQueue model_cache = G_QUEUE_INIT;
+static guint model_cache_items = 0;
+
+static void free_cached_model(CachedModel* cm)
+{
+    g_signal_handler_disconnect(cm->folder, cm->reload_handler);
+    model_cache_items -= cm->n_items;
+    g_object_unref(cm->model);
+    g_slice_free(CachedModel, cm);
+}
+
+/* the model will be refilled so don't keep it */
+static void on_cached_folder_reload(FmFolder* folder, gpointer user_data)
+{
+    GList* l = g_queue_find(&model_cache, user_data);
+    g_queue_delete_link(&model_cache, l);
+    free_cached_model((CachedModel*)user_data);
+}
+
+static void cache_model(FmFolderView* fv)
+{
+    FmFolderModel* model = fm_folder_view_get_model(fv);
+    FmFolder* folder = fm_folder_view_get_folder(fv);
+    CachedModel* cm;
+    guint n_items;
+
+    if(!model || !folder || !fm_folder_is_loaded(folder))
+        return;
+    n_items = fm_file_info_list_get_length(fm_folder_get_files(folder));
+    if(n_items > MODEL_CACHE_MAX_ITEMS)
+        return;
+    cm = g_slice_new(CachedModel);
+    cm->model = g_object_ref(model);
+    cm->folder = folder;
+    cm->show_hidden = fm_folder_model_get_show_hidden(model);
+    gtk_tree_sortable_get_sort_column_id(GTK_TREE_SORTABLE(model),
+                                         &cm->sort_by, &cm->sort_type);
+    cm->n_items = n_items;
+    cm->reload_handler = g_signal_connect(folder, "start-loading",
+                                          G_CALLBACK(on_cached_folder_reload), cm);
+    g_queue_push_head(&model_cache, cm);
+    model_cache_items += n_items;
+
+    /* drop least recently used models */
+    while(model_cache_items > MODEL_CACHE_MAX_ITEMS
+          || g_queue_get_length(&model_cache) > MODEL_CACHE_MAX_MODELS)
+        free_cached_model((CachedModel*)g_queue_pop_tail(&model_cache));
+}
+
+static FmFolderModel* take_cached_model(FmFolder* folder, gboolean show_hidden,
+                                        int sort_by, GtkSortType sort_type)
+{
+    GList* l;
+    for(l = model_cache.head; l; l = l->next)
+    {
+        CachedModel* cm = (CachedModel*)l->data;
+        if(cm->folder == folder && cm->show_hidden == show_hidden
+           && cm->sort_by == sort_by && cm->sort_type == sort_type)
+        {
+            FmFolderModel* model = g_object_ref(cm->model);
+            g_queue_delete_link(&model_cache, l);
+            free_cached_model(cm);
+            return model;
+        }
+    }
+    return NULL;
+}
+
+/* Folders which the user will likely open next are loaded in advance:
+ * the selected folder and the parent folder, after a short delay.
+ * Loaded FmFolder objects are shared, so when the user really goes
+ * there fm_folder_from_path() returns the already loaded folder. */
+
+/* delay before loading a folder, in milliseconds */
+#define PREFETCH_DELAY 400
+/* maximum number of preloaded but not yet used folders */
+#define MAX_PREFETCHED 4
+
+static GQueue prefetched = G_QUEUE_INIT; /* FmFolder*, most recent first */
+static guint n_prefetched = 0; /* number of folders loaded in advance */
+static guint n_prefetch_hits = 0; /* ... and later opened */
+static guint n_prefetch_wasted = 0; /* ... and dropped without use */
+
+static void prefetch_folder(FmPath* path)
+{
+    FmFolder* folder = fm_folder_from_path(path);
+    GList* l = g_queue_find(&prefetched, folder);
+    if(l) /* already there, just make it most recent */
+    {
+        g_queue_unlink(&prefetched, l);
+        g_queue_push_head_link(&prefetched, l);
+        g_object_unref(folder);
+        return;
+    }
+    if(fm_folder_is_loaded(folder)) /* nothing to do */
+    {
+        g_object_unref(folder);
+        return;
+    }
+    g_queue_push_head(&prefetched, folder);
+    ++n_prefetched;
+    while(prefetched.length > MAX_PREFETCHED)
+    {
+        g_object_unref(g_queue_pop_tail(&prefetched));
+        ++n_prefetch_wasted;
+    }
+}
+
+/* the folder is really opened so account it */
+static void take_prefetched(FmFolder* folder)
+{
+    GList* l = g_queue_find(&prefetched, folder);
+    if(l)
+    {
+        g_queue_delete_link(&prefetched, l);
+        g_object_unref(folder);
+        ++n_prefetch_hits;
+    }
+}
+
+static gboolean on_prefetch_timeout(gpointer user_data)
+{
+    FmTabPage* page = (FmTabPage*)user_data;
+    page->prefetch_handler = 0;
+    if(page->prefetch_path)
+    {
+        prefetch_folder(page->prefetch_path);
+        fm_path_unref(page->prefetch_path);
+        page->prefetch_path = NULL;
+    }
+    return FALSE;
+}
+
+static void cancel_prefetch(FmTabPage* page)
+{
+    if(page->prefetch_handler)
+    {
+        g_source_remove(page->prefetch_handler);
+        page->prefetch_handler = 0;
+    }
+    if(page->prefetch_path)
+    {
+        fm_path_unref(page->prefetch_path);
+        page->prefetch_path = NULL;
+    }
+}
+
+static void schedule_prefetch(FmTabPage* page, FmPath* path)
+{
+    cancel_prefetch(page);
+    page->prefetch_path = fm_path_ref(path);
+    page->prefetch_handler = g_timeout_add(PREFETCH_DELAY, on_prefetch_timeout, page);
+}
+
+void fm_tab_page_get_prefetch_stats(guint* n_total, guint* n_hits, guint* n_wasted)
+{
+    if(n_total)
+        *n_total = n_prefetched;
+    if(n_hits)
+        *n_hits = n_prefetch_hits;
+    if(n_wasted)
+        *n_wasted = n_prefetch_wasted;
+}
+
 static void free_folder(FmTabPage* page)
 {
+    cancel_partial_list(page);
+    /* the model may be cached so bring it up to date */
+    stop_churn(page, TRUE);
     if(page->folder)
     {
+        if(page->folder_view)
+            cache_model(page->folder_view);
         g_signal_handlers_disconnect_by_func(page->folder, on_folder_start_loading, page);
         g_signal_handlers_disconnect_by_func(page->folder, on_folder_finish_loading, page);
         g_signal_handlers_disconnect_by_func(page->folder, on_folder_fs_info, page);
         g_signal_handlers_disconnect_by_func(page->folder, on_folder_error, page);
         g_signal_handlers_disconnect_by_func(page->folder, on_folder_content_changed, page);
+        g_signal_handlers_disconnect_by_func(page->folder, on_folder_files_added, page);
+        g_signal_handlers_disconnect_by_func(page->folder, on_folder_files_removed, page);
+        g_signal_handlers_disconnect_by_func(page->folder, on_folder_files_changed, page);
         g_signal_handlers_disconnect_by_func(page->folder, on_folder_removed, page);
         g_signal_handlers_disconnect_by_func(page->folder, on_folder_unmount, page);
         g_object_unref(page->folder);
@@ -143,7 +363,27 @@ void fm_tab_page_destroy(GtkObject *object)
 {
     FmTabPage* page = FM_TAB_PAGE(object);
     /* g_debug("fm_tab_page_destroy"); */
+    pcmanfm_fs_info_remove_notify(update_fs_info_text, page);
+    /* the side pane belongs to the main window */
+    fm_tab_page_set_side_pane(page, NULL);
     free_folder(page);
+    cancel_sel_count(page);
+    cancel_prefetch(page);
+    if(page->hib_path)
+    {
+        fm_path_unref(page->hib_path);
+        page->hib_path = NULL;
+    }
+    if(page->hib_sel)
+    {
+        fm_path_list_unref(page->hib_sel);
+        page->hib_sel = NULL;
+    }
+    if(page->update_status_handler)
+    {
+        g_source_remove(page->update_status_handler);
+        page->update_status_handler = 0;
+    }
     if(page->nav_history)
     {
         g_object_unref(page->nav_history);
@@ -164,29 +404,403 @@ void fm_tab_page_destroy(GtkObject *object)
 #endif
 }
 
-static void on_folder_content_changed(FmFolder* folder, FmTabPage* page)
+static gboolean on_update_status(gpointer user_data)
 {
-    /* update status text */
+    FmTabPage* page = (FmTabPage*)user_data;
+    char* text = format_status_text(page);
+
+    page->update_status_handler = 0;
+    /* don't bother the main window if the text is still the same */
+    if(g_strcmp0(text, page->status_text[FM_STATUS_TEXT_NORMAL]) == 0)
+    {
+        g_free(text);
+        return FALSE;
+    }
     g_free(page->status_text[FM_STATUS_TEXT_NORMAL]);
-    page->status_text[FM_STATUS_TEXT_NORMAL] = format_status_text(page);
+    page->status_text[FM_STATUS_TEXT_NORMAL] = text;
     g_signal_emit(page, signals[STATUS], 0,
                   (guint)FM_STATUS_TEXT_NORMAL,
                   page->status_text[FM_STATUS_TEXT_NORMAL]);
+    return FALSE;
+}
+
+static void on_folder_content_changed(FmFolder* folder, FmTabPage* page)
+{
+    /* content of some folders is changed very often, so update the
+     * status text not more often than a few times per second */
+    if(!page->update_status_handler)
+        page->update_status_handler = g_timeout_add(STATUS_UPDATE_INTERVAL,
+                                                    on_update_status, page);
+}
+
+/* Folders like build directories may change thousands of files per
+ * second. While that happens the model doesn't get every change from the
+ * folder, instead changes are collected here and the model is updated
+ * with all of them at once. */
+
+enum
+{
+    CHURN_ADDED = 1,
+    CHURN_CHANGED,
+    CHURN_REMOVED
+};
+
+typedef struct
+{
+    FmFolderModel* model; /* model which is not updated by the folder */
+    GHashTable* pending; /* FmFileInfo* -> change */
+    guint n_events; /* files changed during current interval */
+    guint n_quiet; /* intervals passed with few changes */
+    guint handler;
+}Churn;
+
+static void add_churn_change(FmTabPage* page, GSList* files, int change)
+{
+    Churn* churn = (Churn*)page->churn;
+    if(!churn)
+    {
+        churn = g_slice_new0(Churn);
+        page->churn = churn;
+    }
+    churn->n_events += g_slist_length(files);
+    if(!churn->model) /* the model is updated by the folder itself */
+        return;
+    for(; files; files = files->next)
+    {
+        FmFileInfo* fi = (FmFileInfo*)files->data;
+        int old = GPOINTER_TO_INT(g_hash_table_lookup(churn->pending, fi));
+        if(old == CHURN_ADDED)
+        {
+            if(change == CHURN_REMOVED) /* the model never had it */
+                g_hash_table_remove(churn->pending, fi);
+            /* changes of a new file are shown when it's added */
+        }
+        else if(old == 0)
+            g_hash_table_insert(churn->pending, fm_file_info_ref(fi),
+                                GINT_TO_POINTER(change));
+        else if(change == CHURN_REMOVED)
+            g_hash_table_replace(churn->pending, fm_file_info_ref(fi),
+                                 GINT_TO_POINTER(change));
+    }
+}
+
+static void apply_churn_change(gpointer key, gpointer value, gpointer user_data)
+{
+    FmFileInfo* fi = (FmFileInfo*)key;
+    FmFolderModel* model = (FmFolderModel*)user_data;
+    switch(GPOINTER_TO_INT(value))
+    {
+    case CHURN_ADDED:
+        fm_folder_model_file_created(model, fi);
+        break;
+    case CHURN_CHANGED:
+        fm_folder_model_file_changed(model, fi);
+        break;
+    case CHURN_REMOVED:
+        fm_folder_model_file_deleted(model, fi);
+        break;
+    }
+}
+
+static void apply_churn(FmTabPage* page)
+{
+    Churn* churn = (Churn*)page->churn;
+    if(g_hash_table_size(churn->pending) == 0)
+        return;
+    g_hash_table_foreach(churn->pending, apply_churn_change, churn->model);
+    g_hash_table_remove_all(churn->pending);
+}
+
+static void stop_churn(FmTabPage* page, gboolean apply)
+{
+    Churn* churn = (Churn*)page->churn;
+    if(!churn)
+        return;
+    if(churn->handler)
+        g_source_remove(churn->handler);
+    if(churn->model)
+    {
+        if(apply)
+            apply_churn(page);
+        g_signal_handlers_unblock_matched(page->folder, G_SIGNAL_MATCH_DATA,
+                                          0, 0, NULL, NULL, churn->model);
+        g_object_unref(churn->model);
+        g_hash_table_destroy(churn->pending);
+    }
+    g_slice_free(Churn, churn);
+    page->churn = NULL;
+}
+
+static gboolean on_churn_timeout(gpointer user_data)
+{
+    FmTabPage* page = (FmTabPage*)user_data;
+    Churn* churn = (Churn*)page->churn;
+    gboolean busy = churn->n_events > CHURN_THRESHOLD;
+
+    churn->n_events = 0;
+    if(churn->model)
+    {
+        apply_churn(page);
+        /* the status text shows number of files in the model */
+        on_folder_content_changed(page->folder, page);
+        if(busy)
+            churn->n_quiet = 0;
+        else if(++churn->n_quiet >= CHURN_QUIET_TICKS)
+        {
+            /* let the folder update the model directly again */
+            churn->handler = 0;
+            stop_churn(page, FALSE);
+            return FALSE;
+        }
+    }
+    else if(busy)
+    {
+        FmFolderModel* model = fm_folder_view_get_model(page->folder_view);
+        /* the model which is shown should be updated by this folder.
+         * Handlers are blocked here and not in the middle of signal
+         * emission, so each change reaches the model exactly once. */
+        if(model && fm_folder_is_loaded(page->folder)
+           && fm_folder_view_get_folder(page->folder_view) == page->folder)
+        {
+            churn->model = g_object_ref(model);
+            churn->pending = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                                   (GDestroyNotify)fm_file_info_unref,
+                                                   NULL);
+            g_signal_handlers_block_matched(page->folder, G_SIGNAL_MATCH_DATA,
+                                            0, 0, NULL, NULL, model);
+        }
+    }
+    else
+    {
+        churn->handler = 0;
+        stop_churn(page, FALSE);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static inline void on_folder_churn(FmTabPage* page, GSList* files, int change)
+{
+    Churn* churn;
+    add_churn_change(page, files, change);
+    churn = (Churn*)page->churn;
+    /* check rate of changes periodically while the folder is changing */
+    if(!churn->handler)
+        churn->handler = g_timeout_add(CHURN_INTERVAL, on_churn_timeout, page);
+}
+
+static void on_folder_files_added(FmFolder* folder, GSList* files, FmTabPage* page)
+{
+    /* free space is changed too, libfm queries it again after changes
+     * and the result comes with "fs-info" */
+    pcmanfm_fs_info_invalidate(folder);
+    on_folder_churn(page, files, CHURN_ADDED);
+}
+
+static void on_folder_files_removed(FmFolder* folder, GSList* files, FmTabPage* page)
+{
+    pcmanfm_fs_info_invalidate(folder);
+    on_folder_churn(page, files, CHURN_REMOVED);
+}
+
+static void on_folder_files_changed(FmFolder* folder, GSList* files, FmTabPage* page)
+{
+    on_folder_churn(page, files, CHURN_CHANGED);
+}
+
+/* Total size of selected files. Sizes of directories are counted
+ * recursively in background and cached by path and mtime. */
+typedef struct
+{
+    FmTabPage* page;
+    int n_sel;
+    goffset size; /* size of files and of already counted folders */
+    GQueue dirs; /* FmFileInfo of folders waiting to be counted */
+    GSList* jobs; /* running FmDeepCountJob */
+}SelCount;
+
+typedef struct
+{
+    time_t mtime;
+    goffset size;
+    GList* lru; /* link in dir_sizes_lru */
+}DirSize;
+
+/* maximum number of folders counted at the same time */
+#define MAX_COUNT_JOBS 4
+/* maximum number of folder sizes to remember */
+#define MAX_DIR_SIZES 1024
+
+static GHashTable* dir_sizes = NULL; /* path string -> DirSize */
+static GQueue dir_sizes_lru = G_QUEUE_INIT; /* paths, recently used first */
+
+static void free_dir_size(DirSize* ds)
+{
+    g_slice_free(DirSize, ds);
+}
+
+static void touch_dir_size(DirSize* ds)
+{
+    g_queue_unlink(&dir_sizes_lru, ds->lru);
+    g_queue_push_head_link(&dir_sizes_lru, ds->lru);
+}
+
+/* path_str is taken by the cache */
+static void remember_dir_size(char* path_str, time_t mtime, goffset size)
+{
+    DirSize* ds = (DirSize*)g_hash_table_lookup(dir_sizes, path_str);
+    if(ds)
+    {
+        g_free(path_str);
+        touch_dir_size(ds);
+    }
+    else
+    {
+        /* forget least recently used folders */
+        while(g_hash_table_size(dir_sizes) >= MAX_DIR_SIZES)
+            g_hash_table_remove(dir_sizes, g_queue_pop_tail(&dir_sizes_lru));
+        ds = g_slice_new(DirSize);
+        g_queue_push_head(&dir_sizes_lru, path_str);
+        ds->lru = dir_sizes_lru.head;
+        g_hash_table_insert(dir_sizes, path_str, ds);
+    }
+    ds->mtime = mtime;
+    ds->size = size;
+}
+
+static void start_count_jobs(SelCount* sc);
+
+static void set_sel_status_text(FmTabPage* page, char* msg)
+{
+    g_free(page->status_text[FM_STATUS_TEXT_SELECTED_FILES]);
+    page->status_text[FM_STATUS_TEXT_SELECTED_FILES] = msg;
+    g_signal_emit(page, signals[STATUS], 0,
+                  (guint)FM_STATUS_TEXT_SELECTED_FILES, msg);
+}
+
+static void update_sel_count_text(SelCount* sc)
+{
+    char size_str[128];
+    char* msg;
+
+    /* sizes of folders are added only when their counting is finished,
+     * the jobs change their totals in another thread while running */
+    fm_file_size_to_str(size_str, sizeof(size_str), sc->size, fm_config->si_unit);
+    if(sc->jobs || sc->dirs.length)
+        msg = g_strdup_printf(ngettext("%d item selected (%s...)", "%d items selected (%s...)", sc->n_sel),
+                              sc->n_sel, size_str);
+    else
+        msg = g_strdup_printf(ngettext("%d item selected (%s)", "%d items selected (%s)", sc->n_sel),
+                              sc->n_sel, size_str);
+    set_sel_status_text(sc->page, msg);
+}
+
+static void on_count_job_finished(FmJob* job, SelCount* sc)
+{
+    FmFileInfo* fi = (FmFileInfo*)g_object_get_data(G_OBJECT(job), "fi");
+    goffset size = ((FmDeepCountJob*)job)->total_size;
+
+    if(!fm_job_is_cancelled(job))
+        remember_dir_size(fm_path_to_str(fm_file_info_get_path(fi)),
+                          fm_file_info_get_mtime(fi), size);
+    sc->size += size;
+    sc->jobs = g_slist_remove(sc->jobs, job);
+    g_object_unref(job);
+
+    start_count_jobs(sc);
+    update_sel_count_text(sc);
+}
+
+static void start_count_jobs(SelCount* sc)
+{
+    while(sc->dirs.length && g_slist_length(sc->jobs) < MAX_COUNT_JOBS)
+    {
+        FmFileInfo* fi = (FmFileInfo*)g_queue_pop_head(&sc->dirs);
+        FmPathList* paths = fm_path_list_new();
+        FmDeepCountJob* job;
+
+        fm_path_list_push_tail(paths, fm_file_info_get_path(fi));
+        job = fm_deep_count_job_new(paths, FM_DC_JOB_DEFAULT);
+        fm_path_list_unref(paths);
+        g_object_set_data_full(G_OBJECT(job), "fi", fi, (GDestroyNotify)fm_file_info_unref);
+        g_signal_connect(job, "finished", G_CALLBACK(on_count_job_finished), sc);
+        sc->jobs = g_slist_prepend(sc->jobs, job);
+        fm_job_run_async(FM_JOB(job));
+    }
+}
+
+static void cancel_sel_count(FmTabPage* page)
+{
+    SelCount* sc = (SelCount*)page->sel_count;
+    GSList* l;
+
+    if(!sc)
+        return;
+    page->sel_count = NULL;
+    for(l = sc->jobs; l; l = l->next)
+    {
+        FmJob* job = FM_JOB(l->data);
+        /* let the job die in background */
+        g_signal_handlers_disconnect_by_func(job, on_count_job_finished, sc);
+        g_signal_connect(job, "finished", G_CALLBACK(g_object_unref), NULL);
+        fm_job_cancel(job);
+    }
+    g_slist_free(sc->jobs);
+    g_queue_foreach(&sc->dirs, (GFunc)fm_file_info_unref, NULL);
+    g_queue_clear(&sc->dirs);
+    g_slice_free(SelCount, sc);
+}
+
+static void count_sel_size(FmTabPage* page, FmFileInfoList* files, int n_sel)
+{
+    SelCount* sc = g_slice_new0(SelCount);
+    GList* l;
+
+    if(G_UNLIKELY(!dir_sizes))
+        dir_sizes = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                          (GDestroyNotify)free_dir_size);
+    sc->page = page;
+    sc->n_sel = n_sel;
+    g_queue_init(&sc->dirs);
+    for(l = fm_file_info_list_peek_head_link(files); l; l = l->next)
+    {
+        FmFileInfo* fi = (FmFileInfo*)l->data;
+        if(fm_file_info_is_dir(fi))
+        {
+            char* path_str = fm_path_to_str(fm_file_info_get_path(fi));
+            DirSize* ds = (DirSize*)g_hash_table_lookup(dir_sizes, path_str);
+            g_free(path_str);
+            if(ds && ds->mtime == fm_file_info_get_mtime(fi))
+            {
+                touch_dir_size(ds);
+                sc->size += ds->size;
+            }
+            else
+                g_queue_push_tail(&sc->dirs, fm_file_info_ref(fi));
+        }
+        else
+            sc->size += fm_file_info_get_size(fi);
+    }
+    page->sel_count = sc;
+    start_count_jobs(sc);
+    update_sel_count_text(sc);
 }
 
 static void on_folder_view_sel_changed(FmFolderView* fv, gint n_sel, FmTabPage* page)
 {
-    char* msg = page->status_text[FM_STATUS_TEXT_SELECTED_FILES];
-    g_free(msg);
+    char* msg = NULL;
 
+    cancel_sel_count(page);
     if(n_sel > 0)
     {
-        /* FIXME: display total size of all selected files. */
         if(n_sel == 1) /* only one file is selected */
         {
             FmFileInfoList* files = fm_folder_view_dup_selected_files(fv);
             FmFileInfo* fi = fm_file_info_list_peek_head(files);
             const char* size_str = fm_file_info_get_disp_size(fi);
+            /* the user may open it soon so start loading it */
+            if(fm_file_info_is_dir(fi))
+                schedule_prefetch(page, fm_file_info_get_path(fi));
             if(size_str)
             {
                 msg = g_strdup_printf("\"%s\" (%s) %s",
@@ -204,14 +818,14 @@ static void on_folder_view_sel_changed(FmFolderView* fv, gint n_sel, FmTabPage*
         }
         else
         {
-            msg = g_strdup_printf(ngettext("%d item selected", "%d items selected", n_sel), n_sel);
+            /* display total size of all selected files. */
+            FmFileInfoList* files = fm_folder_view_dup_selected_files(fv);
+            count_sel_size(page, files, n_sel);
+            fm_file_info_list_unref(files);
+            return;
         }
     }
-    else
-        msg = NULL;
-    page->status_text[FM_STATUS_TEXT_SELECTED_FILES] = msg;
-    g_signal_emit(page, signals[STATUS], 0,
-                  (guint)FM_STATUS_TEXT_SELECTED_FILES, msg);
+    set_sel_status_text(page, msg);
 }
 
 static FmJobErrorAction on_folder_error(FmFolder* folder, GError* err, FmJobErrorSeverity severity, FmTabPage* page)
@@ -239,12 +853,154 @@ static FmJobErrorAction on_folder_error(FmFolder* folder, GError* err, FmJobErro
     return FM_JOB_CONTINUE;
 }
 
+/* libfm 1.0 adds files to a folder only when it's completely loaded,
+ * so a folder which loads slowly is listed once more here in batches,
+ * and the files are shown in a model not connected to the folder.
+ * At finish-loading the model is replaced with a real one. */
+typedef struct
+{
+    FmPath* dir;
+    FmFolderModel* model;
+    GCancellable* cancellable;
+    gboolean running; /* an async operation is pending */
+}PartialList;
+
+static void partial_list_free(PartialList* pl)
+{
+    fm_path_unref(pl->dir);
+    g_object_unref(pl->model);
+    g_object_unref(pl->cancellable);
+    g_slice_free(PartialList, pl);
+}
+
+static void cancel_partial_list(FmTabPage* page)
+{
+    PartialList* pl = (PartialList*)page->partial;
+    if(page->partial_handler)
+    {
+        g_source_remove(page->partial_handler);
+        page->partial_handler = 0;
+    }
+    if(!pl)
+        return;
+    page->partial = NULL;
+    g_cancellable_cancel(pl->cancellable);
+    /* otherwise it's freed when the pending operation returns */
+    if(!pl->running)
+        partial_list_free(pl);
+}
+
+static void partial_list_done(PartialList* pl, GFileEnumerator* enu)
+{
+    if(enu)
+    {
+        g_file_enumerator_close_async(enu, G_PRIORITY_LOW, NULL, NULL, NULL);
+        g_object_unref(enu);
+    }
+    pl->running = FALSE;
+    /* the page doesn't know about it anymore */
+    if(g_cancellable_is_cancelled(pl->cancellable))
+        partial_list_free(pl);
+}
+
+static void on_partial_next_files(GObject* src, GAsyncResult* res, gpointer user_data)
+{
+    PartialList* pl = (PartialList*)user_data;
+    GFileEnumerator* enu = G_FILE_ENUMERATOR(src);
+    GList* infos = g_file_enumerator_next_files_finish(enu, res, NULL);
+    GList* l;
+
+    if(!infos || g_cancellable_is_cancelled(pl->cancellable))
+    {
+        g_list_foreach(infos, (GFunc)g_object_unref, NULL);
+        g_list_free(infos);
+        partial_list_done(pl, enu);
+        return;
+    }
+    for(l = infos; l; l = l->next)
+    {
+        GFileInfo* inf = G_FILE_INFO(l->data);
+        FmFileInfo* fi = fm_file_info_new_from_gfileinfo(pl->dir, inf);
+        fm_folder_model_file_created(pl->model, fi);
+        fm_file_info_unref(fi);
+        g_object_unref(inf);
+    }
+    g_list_free(infos);
+    g_file_enumerator_next_files_async(enu, PARTIAL_LOADING_BATCH, G_PRIORITY_LOW,
+                                       pl->cancellable, on_partial_next_files, pl);
+}
+
+static void on_partial_enumerate(GObject* src, GAsyncResult* res, gpointer user_data)
+{
+    PartialList* pl = (PartialList*)user_data;
+    GFileEnumerator* enu = g_file_enumerate_children_finish(G_FILE(src), res, NULL);
+
+    if(!enu || g_cancellable_is_cancelled(pl->cancellable))
+    {
+        /* errors are reported by the folder itself */
+        partial_list_done(pl, enu);
+        return;
+    }
+    g_file_enumerator_next_files_async(enu, PARTIAL_LOADING_BATCH, G_PRIORITY_LOW,
+                                       pl->cancellable, on_partial_next_files, pl);
+}
+
+static gboolean on_show_partial_folder(gpointer user_data)
+{
+    FmTabPage* page = (FmTabPage*)user_data;
+    PartialList* pl;
+    GFile* gf;
+
+    page->partial_handler = 0;
+    if(!page->folder || fm_folder_is_loaded(page->folder))
+        return FALSE;
+    pl = g_slice_new(PartialList);
+    pl->dir = fm_path_ref(fm_folder_get_path(page->folder));
+    pl->model = fm_folder_model_new(page->folder, app_config->show_hidden);
+    /* the model should show files listed here only */
+    g_signal_handlers_disconnect_matched(page->folder, G_SIGNAL_MATCH_DATA,
+                                         0, 0, NULL, NULL, pl->model);
+    pl->cancellable = g_cancellable_new();
+    pl->running = TRUE;
+    page->partial = pl;
+    fm_folder_view_set_model(page->folder_view, pl->model);
+
+    gf = fm_path_to_gfile(pl->dir);
+    g_file_enumerate_children_async(gf, PARTIAL_LOADING_ATTRIBUTES, 0, G_PRIORITY_LOW,
+                                    pl->cancellable, on_partial_enumerate, pl);
+    g_object_unref(gf);
+    return FALSE;
+}
+
 static void on_folder_start_loading(FmFolder* folder, FmTabPage* page)
 {
+    /* the folder is reloaded so collected changes are useless */
+    stop_churn(page, FALSE);
     /* g_debug("start-loading"); */
+    if(pcmanfm_trace_is_running())
+    {
+        char* path_str = fm_path_to_str(fm_folder_get_path(folder));
+        pcmanfm_trace_mark("folder start loading", "path", path_str);
+        g_free(path_str);
+    }
     /* FIXME: this should be set on toplevel parent */
     fm_set_busy_cursor(GTK_WIDGET(page));
+    cancel_partial_list(page);
+    /* loading remote folder may take long time, show its old listing meanwhile */
+    if(pcmanfm_folder_snapshot_is_wanted(fm_folder_get_path(folder)))
+    {
+        FmFolderModel* model = pcmanfm_folder_snapshot_load(folder, app_config->show_hidden);
+        if(model)
+        {
+            fm_folder_view_set_model(page->folder_view, model);
+            g_object_unref(model);
+            return;
+        }
+    }
     fm_folder_view_set_model(page->folder_view, NULL);
+    /* if loading takes long, show files listed so far */
+    page->partial_handler = g_timeout_add(PARTIAL_LOADING_DELAY,
+                                          on_show_partial_folder, page);
 }
 
 static void on_folder_finish_loading(FmFolder* folder, FmTabPage* page)
@@ -253,16 +1009,40 @@ static void on_folder_finish_loading(FmFolder* folder, FmTabPage* page)
     const FmNavHistoryItem* item;
     GtkScrolledWindow* scroll = GTK_SCROLLED_WINDOW(fv);
 
-    /* create a model for the folder and set it to the view */
-    FmFolderModel* model = fm_folder_model_new(folder, app_config->show_hidden);
+    FmFolderModel* model;
+
+    /* the real model replaces files listed while loading */
+    cancel_partial_list(page);
+    /* reuse a model for the folder if we have one, or create it */
+    model = take_cached_model(folder, app_config->show_hidden,
+                              fm_folder_view_get_sort_by(fv),
+                              fm_folder_view_get_sort_type(fv));
+    if(!model)
+        model = fm_folder_model_new(folder, app_config->show_hidden);
     fm_folder_view_set_model(fv, model);
     g_object_unref(model);
-    fm_folder_query_filesystem_info(folder); /* FIXME: is this needed? */
+    /* free space is shared with other folders on the same file system */
+    pcmanfm_fs_info_query(folder);
+    update_fs_info_text(page);
+    if(pcmanfm_folder_snapshot_is_wanted(fm_folder_get_path(folder)))
+        pcmanfm_folder_snapshot_save(folder);
 
     // fm_path_entry_set_path(entry, path);
     /* scroll to recorded position */
     item = fm_nav_history_get_cur(page->nav_history);
-    gtk_adjustment_set_value(gtk_scrolled_window_get_vadjustment(scroll), item->scroll_pos);
+    if(page->hib_scroll >= 0) /* woken from hibernation */
+    {
+        gtk_adjustment_set_value(gtk_scrolled_window_get_vadjustment(scroll), page->hib_scroll);
+        page->hib_scroll = -1;
+    }
+    else
+        gtk_adjustment_set_value(gtk_scrolled_window_get_vadjustment(scroll), item->scroll_pos);
+    if(page->hib_sel)
+    {
+        fm_folder_view_select_file_paths(fv, page->hib_sel);
+        fm_path_list_unref(page->hib_sel);
+        page->hib_sel = NULL;
+    }
 
     /* update status bar */
     /* update status text */
@@ -273,6 +1053,12 @@ static void on_folder_finish_loading(FmFolder* folder, FmTabPage* page)
                   page->status_text[FM_STATUS_TEXT_NORMAL]);
 
     fm_unset_busy_cursor(GTK_WIDGET(fv));
+    if(pcmanfm_trace_is_running())
+    {
+        char* path_str = fm_path_to_str(fm_folder_get_path(folder));
+        pcmanfm_trace_mark("folder loaded", "path", path_str);
+        g_free(path_str);
+    }
     /* g_debug("finish-loading"); */
 }
 
@@ -288,11 +1074,20 @@ static void on_folder_removed(FmFolder* folder, FmTabPage* page)
 
 static void on_folder_fs_info(FmFolder* folder, FmTabPage* page)
 {
-    guint64 free, total;
-    char* msg = page->status_text[FM_STATUS_TEXT_FS_INFO];
-    g_free(msg);
     /* g_debug("%p, fs-info: %d", folder, (int)folder->has_fs_info); */
-    if(fm_folder_get_filesystem_info(folder, &total, &free))
+    /* this notifies all pages including this one */
+    pcmanfm_fs_info_update(folder);
+}
+
+static void update_fs_info_text(gpointer user_data)
+{
+    FmTabPage* page = (FmTabPage*)user_data;
+    guint64 free, total;
+    char* msg;
+
+    if(!page->folder)
+        return;
+    if(pcmanfm_fs_info_get(page->folder, &total, &free))
     {
         char total_str[ 64 ];
         char free_str[ 64 ];
@@ -302,6 +1097,13 @@ static void on_folder_fs_info(FmFolder* folder, FmTabPage* page)
     }
     else
         msg = NULL;
+    /* don't bother the main window if the text is still the same */
+    if(g_strcmp0(msg, page->status_text[FM_STATUS_TEXT_FS_INFO]) == 0)
+    {
+        g_free(msg);
+        return;
+    }
+    g_free(page->status_text[FM_STATUS_TEXT_FS_INFO]);
     page->status_text[FM_STATUS_TEXT_FS_INFO] = msg;
     g_signal_emit(page, signals[STATUS], 0,
                   (guint)FM_STATUS_TEXT_FS_INFO, msg);
@@ -335,12 +1137,11 @@ static void fm_tab_page_init(FmTabPage *page)
     FmTabLabel* tab_label;
     FmFolderView* folder_view;
     GList* focus_chain = NULL;
+    GTimeVal now;
 
-    page->side_pane = fm_side_pane_new();
-    fm_side_pane_set_mode(page->side_pane, app_config->side_pane_mode);
-    /* TODO: add a close button to side pane */
-    gtk_paned_add1(paned, GTK_WIDGET(page->side_pane));
-    focus_chain = g_list_prepend(focus_chain, page->side_pane);
+    pcmanfm_fs_info_add_notify(update_fs_info_text, page);
+
+    /* the side pane is added by the main window, see fm_tab_page_set_side_pane() */
 
     folder_view = fm_folder_view_new(app_config->view_mode);
     page->folder_view = folder_view;
@@ -364,6 +1165,9 @@ static void fm_tab_page_init(FmTabPage *page)
 
     g_signal_connect(page->folder_view, "sel-changed",
                      G_CALLBACK(on_folder_view_sel_changed), page);
+    page->hib_scroll = -1;
+    g_get_current_time(&now);
+    page->active_time = now.tv_sec;
     /*
     g_signal_connect(page->folder_view, "chdir",
                      G_CALLBACK(on_folder_view_chdir), page);
@@ -383,7 +1187,42 @@ FmTabPage *fm_tab_page_new(FmPath* path)
     FmTabPage* page = (FmTabPage*)g_object_new(FM_TYPE_TAB_PAGE, NULL);
 
     fm_folder_view_set_show_hidden(page->folder_view, app_config->show_hidden);
-    fm_tab_page_chdir(page, path);
+    /* page without folder can be created beforehand and used later */
+    if(path)
+        fm_tab_page_chdir(page, path);
+    return page;
+}
+
+/* the page is created as if hibernated, the folder is loaded when it's
+ * shown first time, see fm_tab_page_wake() */
+FmTabPage* fm_tab_page_new_deferred(FmPath* path)
+{
+    return fm_tab_page_new_with_history(&path, 1, 0, -1);
+}
+
+FmTabPage* fm_tab_page_new_with_history(FmPath** paths, guint n_paths,
+                                        guint cur, int scroll_pos)
+{
+    FmTabPage* page = fm_tab_page_new(NULL);
+    const GList* l;
+    char* disp_name;
+    guint i;
+
+    g_return_val_if_fail(cur < n_paths, page);
+    for(i = 0; i < n_paths; ++i)
+        fm_nav_history_chdir(page->nav_history, paths[i], 0);
+    /* the newest item is the first one in the list */
+    l = g_list_nth((GList*)fm_nav_history_list(page->nav_history), n_paths - 1 - cur);
+    if(l && l != fm_nav_history_get_cur_link(page->nav_history))
+        /* FIXME: need to avoid cast from const GList */
+        fm_nav_history_jump(page->nav_history, (GList*)l, 0);
+
+    disp_name = fm_path_display_basename(paths[cur]);
+    fm_tab_label_set_text(page->tab_label, disp_name);
+    g_free(disp_name);
+    page->hib_path = fm_path_ref(paths[cur]);
+    page->hib_scroll = scroll_pos;
+    page->hibernated = TRUE;
     return page;
 }
 
@@ -396,6 +1235,7 @@ static void fm_tab_page_chdir_without_history(FmTabPage* page, FmPath* path)
     free_folder(page);
 
     page->folder = fm_folder_from_path(path);
+    take_prefetched(page->folder);
     g_signal_connect(page->folder, "start-loading", G_CALLBACK(on_folder_start_loading), page);
     g_signal_connect(page->folder, "finish-loading", G_CALLBACK(on_folder_finish_loading), page);
     g_signal_connect(page->folder, "error", G_CALLBACK(on_folder_error), page);
@@ -404,16 +1244,23 @@ static void fm_tab_page_chdir_without_history(FmTabPage* page, FmPath* path)
     g_signal_connect(page->folder, "removed", G_CALLBACK(on_folder_removed), page);
     g_signal_connect(page->folder, "unmount", G_CALLBACK(on_folder_unmount), page);
     g_signal_connect(page->folder, "content-changed", G_CALLBACK(on_folder_content_changed), page);
+    g_signal_connect(page->folder, "files-added", G_CALLBACK(on_folder_files_added), page);
+    g_signal_connect(page->folder, "files-removed", G_CALLBACK(on_folder_files_removed), page);
+    g_signal_connect(page->folder, "files-changed", G_CALLBACK(on_folder_files_changed), page);
 
     if(fm_folder_is_loaded(page->folder))
     {
         on_folder_finish_loading(page->folder, page);
-        on_folder_fs_info(page->folder, page);
     }
     else
         on_folder_start_loading(page->folder, page);
 
-    fm_side_pane_chdir(page->side_pane, path);
+    if(page->side_pane)
+        fm_side_pane_chdir(page->side_pane, path);
+
+    /* the user may want to go up later */
+    if(fm_path_get_parent(path))
+        schedule_prefetch(page, fm_path_get_parent(path));
 
     /* tell the world that our current working directory is changed */
     g_signal_emit(page, signals[CHDIR], 0, path);
@@ -428,6 +1275,7 @@ void fm_tab_page_chdir(FmTabPage* page, FmPath* path)
     scroll_pos = gtk_adjustment_get_value(gtk_scrolled_window_get_vadjustment(GTK_SCROLLED_WINDOW(page->folder_view)));
     fm_nav_history_chdir(page->nav_history, path, scroll_pos);
     fm_tab_page_chdir_without_history(page, path);
+    pcmanfm_dir_history_add(path);
 }
 
 void fm_tab_page_set_show_hidden(FmTabPage* page, gboolean show_hidden)
@@ -443,6 +1291,8 @@ void fm_tab_page_set_show_hidden(FmTabPage* page, gboolean show_hidden)
 
 FmPath* fm_tab_page_get_cwd(FmTabPage* page)
 {
+    if(page->hibernated)
+        return page->hib_path;
     return page->folder ? fm_folder_get_path(page->folder) : NULL;
 }
 
@@ -451,6 +1301,33 @@ FmSidePane* fm_tab_page_get_side_pane(FmTabPage* page)
     return page->side_pane;
 }
 
+/* The side pane is owned by the main window and shared by its tabs,
+ * only current tab has it. The caller should keep a reference on it. */
+void fm_tab_page_set_side_pane(FmTabPage* page, FmSidePane* sp)
+{
+    GList* focus_chain = NULL;
+    FmPath* cwd;
+
+    if(page->side_pane == sp)
+        return;
+    if(page->side_pane)
+        gtk_container_remove(GTK_CONTAINER(page), GTK_WIDGET(page->side_pane));
+    page->side_pane = sp;
+    if(sp)
+    {
+        /* TODO: add a close button to side pane */
+        gtk_paned_add1(GTK_PANED(page), GTK_WIDGET(sp));
+        focus_chain = g_list_prepend(focus_chain, sp);
+        cwd = fm_tab_page_get_cwd(page);
+        if(cwd)
+            fm_side_pane_chdir(sp, cwd);
+    }
+    focus_chain = g_list_prepend(focus_chain, page->folder_view);
+    /* We need this to change tab order to focus folder view before left pane. */
+    gtk_container_set_focus_chain(GTK_CONTAINER(page), focus_chain);
+    g_list_free(focus_chain);
+}
+
 FmFolderView* fm_tab_page_get_folder_view(FmTabPage* page)
 {
     return page->folder_view;
@@ -513,6 +1390,42 @@ const char* fm_tab_page_get_status_text(FmTabPage* page, FmStatusTextType type)
     return (type < FM_STATUS_TEXT_NUM) ? page->status_text[type] : NULL;
 }
 
+void fm_tab_page_hibernate(FmTabPage* page)
+{
+    GtkAdjustment* vadj;
+
+    if(page->hibernated || !page->folder || !fm_folder_is_loaded(page->folder))
+        return;
+    page->hib_path = fm_path_ref(fm_folder_get_path(page->folder));
+    vadj = gtk_scrolled_window_get_vadjustment(GTK_SCROLLED_WINDOW(page->folder_view));
+    page->hib_scroll = (int)gtk_adjustment_get_value(vadj);
+    page->hib_sel = fm_folder_view_dup_selected_file_paths(page->folder_view);
+    cancel_sel_count(page);
+    cancel_prefetch(page);
+    if(page->update_status_handler)
+    {
+        g_source_remove(page->update_status_handler);
+        page->update_status_handler = 0;
+    }
+    /* unset the model first so free_folder() doesn't keep it in cache */
+    fm_folder_view_set_model(page->folder_view, NULL);
+    free_folder(page);
+    page->hibernated = TRUE;
+}
+
+void fm_tab_page_wake(FmTabPage* page)
+{
+    FmPath* path;
+
+    if(!page->hibernated)
+        return;
+    page->hibernated = FALSE;
+    path = page->hib_path;
+    page->hib_path = NULL;
+    fm_tab_page_chdir_without_history(page, path);
+    fm_path_unref(path);
+}
+
 void fm_tab_page_reload(FmTabPage* page)
 {
     FmFolder* folder = fm_folder_view_get_folder(page->folder_view);
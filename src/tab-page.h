@@ -52,12 +52,25 @@ typedef struct _FmTabPageClass        FmTabPageClass;
 struct _FmTabPage
 {
     GtkHPaned parent;
-    FmSidePane* side_pane;
+    FmSidePane* side_pane; /* shared with other tabs, NULL if not current */
     FmFolderView* folder_view;
     FmTabLabel* tab_label;
     FmNavHistory* nav_history;
     char* status_text[FM_STATUS_TEXT_NUM];
     FmFolder* folder;
+    guint update_status_handler;
+    gpointer sel_count; /* total size of selected files being counted */
+    guint prefetch_handler;
+    FmPath* prefetch_path;
+    glong active_time; /* last time the page was shown, in seconds */
+    guint partial_handler;
+    gpointer partial; /* listing of the folder while it's loading */
+    gpointer churn; /* state of frequently changed folder */
+    /* hibernated page has no folder loaded and keeps only these */
+    gboolean hibernated;
+    FmPath* hib_path;
+    int hib_scroll;
+    FmPathList* hib_sel;
 };
 
 struct _FmTabPageClass
@@ -80,6 +93,7 @@ void fm_tab_page_set_show_hidden(FmTabPage* page, gboolean show_hidden);
 FmPath* fm_tab_page_get_cwd(FmTabPage* page);
 
 FmSidePane* fm_tab_page_get_side_pane(FmTabPage* page);
+void fm_tab_page_set_side_pane(FmTabPage* page, FmSidePane* sp);
 
 FmFolderView* fm_tab_page_get_folder_view(FmTabPage* page);
 
@@ -104,6 +118,23 @@ const char* fm_tab_page_get_title(FmTabPage* page);
 /* get normal status text */
 const char* fm_tab_page_get_status_text(FmTabPage* page, FmStatusTextType type);
 
+/* release the folder and its model but keep the state to restore it later */
+void fm_tab_page_hibernate(FmTabPage* page);
+
+/* load the folder of hibernated page again */
+void fm_tab_page_wake(FmTabPage* page);
+
+/* create a page which doesn't load the folder until it's shown */
+FmTabPage* fm_tab_page_new_deferred(FmPath* path);
+
+/* same as above but with navigation history, paths are listed from the
+ * oldest one, cur is index of current folder in them */
+FmTabPage* fm_tab_page_new_with_history(FmPath** paths, guint n_paths,
+                                        guint cur, int scroll_pos);
+
+/* get statistics of speculative folder loading */
+void fm_tab_page_get_prefetch_stats(guint* n_total, guint* n_hits, guint* n_wasted);
+
 G_END_DECLS
 
 #endif /* __FM_TAB_PAGE_H__ */
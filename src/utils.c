@@ -21,3 +21,209 @@
 
 #include "utils.h"
 
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+/* don't let the trace grow forever if pcmanfm runs for long time */
+#define MAX_TRACE_EVENTS 4096
+
+typedef struct
+{
+    char* name;
+    const char* arg_name;
+    char* arg;
+    char phase; /* 'X' - complete event, 'i' - instant event */
+    gint64 ts;
+    gint64 dur;
+} TraceEvent;
+
+static GArray* trace_events = NULL;
+static gint64 trace_origin = 0;
+static guint trace_dropped = 0;
+
+static inline gint64 get_time(void)
+{
+#if GLIB_CHECK_VERSION(2, 28, 0)
+    return g_get_monotonic_time();
+#else
+    GTimeVal tv;
+    g_get_current_time(&tv);
+    return (gint64)tv.tv_sec * G_USEC_PER_SEC + tv.tv_usec;
+#endif
+}
+
+void pcmanfm_trace_start(void)
+{
+    if(trace_events)
+        return;
+    trace_events = g_array_sized_new(FALSE, FALSE, sizeof(TraceEvent), 64);
+    trace_origin = get_time();
+    trace_dropped = 0;
+}
+
+gboolean pcmanfm_trace_is_running(void)
+{
+    return trace_events != NULL;
+}
+
+gint64 pcmanfm_trace_now(void)
+{
+    return trace_events ? get_time() : 0;
+}
+
+static void add_event(const char* name, const char* arg_name, const char* arg,
+                      char phase, gint64 start, gint64 end)
+{
+    TraceEvent ev;
+    if(!trace_events)
+        return;
+    if(trace_events->len >= MAX_TRACE_EVENTS)
+    {
+        /* drop the previous event instead so the last one is kept */
+        TraceEvent* last = &g_array_index(trace_events, TraceEvent, trace_events->len - 1);
+        g_free(last->name);
+        g_free(last->arg);
+        g_array_set_size(trace_events, trace_events->len - 1);
+        ++trace_dropped;
+    }
+    ev.name = g_strdup(name);
+    ev.arg_name = arg_name;
+    ev.arg = g_strdup(arg);
+    ev.phase = phase;
+    ev.ts = start - trace_origin;
+    ev.dur = end - start;
+    g_array_append_val(trace_events, ev);
+}
+
+void pcmanfm_trace_phase(const char* name, gint64 start)
+{
+    if(trace_events)
+        add_event(name, NULL, NULL, 'X', start, get_time());
+}
+
+void pcmanfm_trace_mark(const char* name, const char* arg_name, const char* arg)
+{
+    if(trace_events)
+    {
+        gint64 now = get_time();
+        add_event(name, arg_name, arg, 'i', now, now);
+    }
+}
+
+static void write_json_string(GString* buf, const char* str)
+{
+    g_string_append_c(buf, '"');
+    for(; *str; ++str)
+    {
+        switch(*str)
+        {
+        case '"':
+            g_string_append(buf, "\\\"");
+            break;
+        case '\\':
+            g_string_append(buf, "\\\\");
+            break;
+        default:
+            if((guchar)*str < 0x20)
+                g_string_append_printf(buf, "\\u%04x", (guint)*str);
+            else
+                g_string_append_c(buf, *str);
+        }
+    }
+    g_string_append_c(buf, '"');
+}
+
+/* writes collected events into file if it's not NULL and stops tracer */
+void pcmanfm_trace_stop(const char* file)
+{
+    guint i;
+
+    if(!trace_events)
+        return;
+    if(file)
+    {
+        GString* buf = g_string_sized_new(4096);
+        int pid = (int)getpid();
+
+        g_string_append(buf, "{\"traceEvents\":[\n");
+        for(i = 0; i < trace_events->len; i++)
+        {
+            TraceEvent* ev = &g_array_index(trace_events, TraceEvent, i);
+            g_string_append(buf, "{\"name\":");
+            write_json_string(buf, ev->name);
+            g_string_append_printf(buf, ",\"cat\":\"startup\",\"ph\":\"%c\",\"ts\":%" G_GINT64_FORMAT
+                                        ",\"pid\":%d,\"tid\":1",
+                                   ev->phase, ev->ts, pid);
+            if(ev->phase == 'X')
+                g_string_append_printf(buf, ",\"dur\":%" G_GINT64_FORMAT, ev->dur);
+            else
+                g_string_append(buf, ",\"s\":\"p\"");
+            if(ev->arg)
+            {
+                g_string_append(buf, ",\"args\":{");
+                write_json_string(buf, ev->arg_name ? ev->arg_name : "arg");
+                g_string_append_c(buf, ':');
+                write_json_string(buf, ev->arg);
+                g_string_append_c(buf, '}');
+            }
+            g_string_append(buf, (i + 1 < trace_events->len) ? "},\n" : "}\n");
+        }
+        g_string_append_printf(buf, "],\"displayTimeUnit\":\"ms\","
+                                    "\"otherData\":{\"droppedEvents\":\"%u\"}}\n",
+                               trace_dropped);
+        if(!g_file_set_contents(file, buf->str, buf->len, NULL))
+            g_warning("cannot write startup trace to %s", file);
+        g_string_free(buf, TRUE);
+    }
+    for(i = 0; i < trace_events->len; i++)
+    {
+        TraceEvent* ev = &g_array_index(trace_events, TraceEvent, i);
+        g_free(ev->name);
+        g_free(ev->arg);
+    }
+    g_array_free(trace_events, TRUE);
+    trace_events = NULL;
+}
+
+void pcmanfm_get_resource_usage(gulong* rss_kb, guint* n_watches)
+{
+#ifdef __linux__
+    char* data;
+    GDir* dir;
+    const char* name;
+#endif
+
+    *rss_kb = 0;
+    *n_watches = 0;
+#ifdef __linux__
+    if(g_file_get_contents("/proc/self/statm", &data, NULL, NULL))
+    {
+        unsigned long size, rss;
+        if(sscanf(data, "%lu %lu", &size, &rss) == 2)
+            *rss_kb = rss * (sysconf(_SC_PAGESIZE) / 1024);
+        g_free(data);
+    }
+    dir = g_dir_open("/proc/self/fdinfo", 0, NULL);
+    if(dir)
+    {
+        while((name = g_dir_read_name(dir)) != NULL)
+        {
+            char* path = g_build_filename("/proc/self/fdinfo", name, NULL);
+            if(g_file_get_contents(path, &data, NULL, NULL))
+            {
+                /* each watch of inotify fd is listed as a line */
+                char* p = data;
+                while((p = strstr(p, "inotify wd:")) != NULL)
+                {
+                    ++*n_watches;
+                    p += 11;
+                }
+                g_free(data);
+            }
+            g_free(path);
+        }
+        g_dir_close(dir);
+    }
+#endif
+}
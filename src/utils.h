@@ -27,6 +27,28 @@
 
 G_BEGIN_DECLS
 
+/* Startup tracer. Timestamps are collected from pcmanfm_trace_start()
+ * until pcmanfm_trace_stop() and are written in Chrome trace-event JSON
+ * format, see --startup-trace option. All calls are no-op if tracer
+ * is not running. */
+void pcmanfm_trace_start(void);
+void pcmanfm_trace_stop(const char* file);
+
+gboolean pcmanfm_trace_is_running(void);
+
+/* get a timestamp to pass to pcmanfm_trace_phase() later */
+gint64 pcmanfm_trace_now(void);
+
+/* record a phase which began at start and is finished now */
+void pcmanfm_trace_phase(const char* name, gint64 start);
+
+/* record an instant event, arg is optional and is written under the
+ * static string arg_name */
+void pcmanfm_trace_mark(const char* name, const char* arg_name, const char* arg);
+
+/* get resident memory size and number of inotify watches of the process,
+ * both are set to 0 if cannot be found out, e.g. on systems other than Linux */
+void pcmanfm_get_resource_usage(gulong* rss_kb, guint* n_watches);
 
 G_END_DECLS
 
@@ -29,6 +29,7 @@
 #include "pcmanfm.h"
 #include "main-win.h"
 #include "app-config.h"
+#include "utils.h"
 
 static GVolumeMonitor* vol_mon = NULL;
 
@@ -282,6 +283,7 @@ static void on_vol_changed(GVolumeMonitor* vm, GVolume* vol, gpointer user_data)
 static gboolean fm_volume_manager_delay_init(gpointer user_data)
 {
     GList* vols, *l;
+    gint64 t = pcmanfm_trace_now();
     vol_mon = g_volume_monitor_get();
     if(G_UNLIKELY(!vol_mon))
         goto _end;
@@ -307,6 +309,7 @@ static gboolean fm_volume_manager_delay_init(gpointer user_data)
         g_list_free(vols);
     }
 _end:
+    pcmanfm_trace_phase("fm_volume_manager_init", t);
     on_idle_handler = 0;
     return FALSE;
 }